@@ -0,0 +1,293 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <libubox/blobmsg.h>
+#include <libubox/blobmsg_json.h>
+
+#include "cache.h"
+
+#define UQMI_CACHE_MAX_ENTRIES	16
+
+static struct {
+	char *name;
+	struct blob_attr *data;
+} cache_entries[UQMI_CACHE_MAX_ENTRIES];
+static int cache_n_entries;
+static char *cache_file;
+static char cache_identity[128];
+static bool cache_dirty;
+
+/*
+ * Look up the serial number of the USB device the control node belongs to,
+ * falling back to the name of the node itself (e.g. for PCIe modems).
+ */
+static void uqmi_cache_get_key(const char *device, char *buf, int len)
+{
+	const char *name = strrchr(device, '/');
+	char path[256];
+	FILE *f;
+	int i;
+
+	name = name ? name + 1 : device;
+	snprintf(buf, len, "%s", name);
+
+	snprintf(path, sizeof(path), "/sys/class/usbmisc/%s/device/../serial", name);
+	f = fopen(path, "r");
+	if (f) {
+		if (!fgets(buf, len, f))
+			snprintf(buf, len, "%s", name);
+		fclose(f);
+	}
+
+	for (i = 0; buf[i]; i++) {
+		if (buf[i] == '\n') {
+			buf[i] = 0;
+			break;
+		}
+
+		if (!isalnum(buf[i]) && buf[i] != '-' && buf[i] != '_')
+			buf[i] = '_';
+	}
+}
+
+static void uqmi_cache_read_attr(const char *dir, const char *attr, char *buf, int len)
+{
+	char path[PATH_MAX];
+	FILE *f;
+	int i;
+
+	*buf = 0;
+	snprintf(path, sizeof(path), "%s/%s", dir, attr);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+
+	if (!fgets(buf, len, f))
+		*buf = 0;
+	fclose(f);
+
+	for (i = 0; buf[i]; i++)
+		if (buf[i] == '\n')
+			buf[i] = 0;
+}
+
+/*
+ * Identify the current instance of the modem from host side state only, so
+ * that checking the cache does not cost any requests. A firmware update or
+ * a reset makes the modem enumerate again, which gives the USB device a new
+ * device number and the control node a new creation time.
+ */
+static void uqmi_cache_get_identity(const char *device, char *buf, int len)
+{
+	static const char * const attrs[] = {
+		"idVendor", "idProduct", "bcdDevice", "busnum", "devnum",
+	};
+	const char *name = strrchr(device, '/');
+	char dir[256], val[32];
+	struct stat st;
+	int i, ofs;
+
+	name = name ? name + 1 : device;
+	snprintf(dir, sizeof(dir), "/sys/class/usbmisc/%s/device/..", name);
+
+	ofs = 0;
+	if (!stat(device, &st))
+		ofs = snprintf(buf, len, "%lx:%lld", (unsigned long) st.st_rdev,
+			       (long long) st.st_ctime);
+
+	for (i = 0; i < ARRAY_SIZE(attrs) && ofs < len; i++) {
+		uqmi_cache_read_attr(dir, attrs[i], val, sizeof(val));
+		ofs += snprintf(buf + ofs, len - ofs, ":%s", val);
+	}
+}
+
+static void uqmi_cache_load(void)
+{
+	enum {
+		CACHE_IDENTITY,
+		CACHE_RESULTS,
+		__CACHE_MAX
+	};
+	static const struct blobmsg_policy policy[__CACHE_MAX] = {
+		[CACHE_IDENTITY] = { "identity", BLOBMSG_TYPE_STRING },
+		[CACHE_RESULTS] = { "results", BLOBMSG_TYPE_TABLE },
+	};
+	struct blob_attr *tb[__CACHE_MAX], *cur;
+	struct blob_buf b = {};
+	int rem;
+
+	blobmsg_buf_init(&b);
+	if (!blobmsg_add_json_from_file(&b, cache_file))
+		goto out;
+
+	blobmsg_parse(policy, __CACHE_MAX, tb, blob_data(b.head), blob_len(b.head));
+	if (!tb[CACHE_IDENTITY] ||
+	    strcmp(blobmsg_get_string(tb[CACHE_IDENTITY]), cache_identity) != 0) {
+		/* written for an earlier instance of the modem, start over */
+		blob_buf_free(&b);
+		cache_dirty = true;
+		return;
+	}
+
+	blobmsg_for_each_attr(cur, tb[CACHE_RESULTS], rem)
+		uqmi_cache_set(blobmsg_name(cur), cur);
+
+out:
+	blob_buf_free(&b);
+	cache_dirty = false;
+}
+
+static void uqmi_cache_save(void)
+{
+	struct blob_buf b = {};
+	char tmp[PATH_MAX];
+	char *str;
+	void *c;
+	FILE *f;
+	int i;
+
+	blobmsg_buf_init(&b);
+	blobmsg_add_string(&b, "identity", cache_identity);
+	c = blobmsg_open_table(&b, "results");
+	for (i = 0; i < cache_n_entries; i++) {
+		struct blob_attr *data = cache_entries[i].data;
+
+		blobmsg_add_field(&b, blobmsg_type(data), cache_entries[i].name,
+				  blobmsg_data(data), blobmsg_data_len(data));
+	}
+	blobmsg_close_table(&b, c);
+
+	str = blobmsg_format_json(b.head, true);
+	blob_buf_free(&b);
+	if (!str)
+		return;
+
+	/* replace the file atomically, concurrent readers see either version */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", cache_file);
+	f = fopen(tmp, "w");
+	if (!f) {
+		fprintf(stderr, "Failed to write cache file %s\n", tmp);
+		goto out;
+	}
+
+	fprintf(f, "%s\n", str);
+	if (fclose(f) || rename(tmp, cache_file))
+		unlink(tmp);
+
+out:
+	free(str);
+}
+
+int uqmi_cache_init(const char *dir, const char *device)
+{
+	char key[64];
+
+	uqmi_cache_get_key(device, key, sizeof(key));
+	cache_file = malloc(strlen(dir) + strlen(key) + sizeof("/.json"));
+	if (!cache_file)
+		return -1;
+
+	sprintf(cache_file, "%s/%s.json", dir, key);
+	uqmi_cache_get_identity(device, cache_identity, sizeof(cache_identity));
+
+	uqmi_cache_load();
+	return 0;
+}
+
+bool uqmi_cache_enabled(void)
+{
+	return !!cache_file;
+}
+
+struct blob_attr *uqmi_cache_get(const char *name)
+{
+	int i;
+
+	for (i = 0; i < cache_n_entries; i++)
+		if (!strcmp(cache_entries[i].name, name))
+			return cache_entries[i].data;
+
+	return NULL;
+}
+
+void uqmi_cache_set(const char *name, struct blob_attr *data)
+{
+	int i;
+
+	for (i = 0; i < cache_n_entries; i++)
+		if (!strcmp(cache_entries[i].name, name))
+			break;
+
+	if (i == cache_n_entries) {
+		if (i == UQMI_CACHE_MAX_ENTRIES)
+			return;
+
+		cache_entries[i].name = strdup(name);
+		cache_n_entries++;
+	} else {
+		free(cache_entries[i].data);
+	}
+
+	cache_entries[i].data = blob_memdup(data);
+	cache_dirty = true;
+}
+
+void uqmi_cache_clear(void)
+{
+	int i;
+
+	for (i = 0; i < cache_n_entries; i++) {
+		free(cache_entries[i].name);
+		free(cache_entries[i].data);
+	}
+	cache_n_entries = 0;
+	cache_dirty = true;
+}
+
+/* forget everything, e.g. because the modem is being reset */
+void uqmi_cache_drop(void)
+{
+	if (!cache_file)
+		return;
+
+	uqmi_cache_clear();
+	unlink(cache_file);
+	cache_dirty = false;
+}
+
+void uqmi_cache_done(void)
+{
+	if (!cache_file)
+		return;
+
+	if (cache_dirty)
+		uqmi_cache_save();
+
+	uqmi_cache_clear();
+	free(cache_file);
+	cache_file = NULL;
+}
@@ -0,0 +1,42 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __UQMI_CACHE_H
+#define __UQMI_CACHE_H
+
+#include <stdbool.h>
+
+struct blob_attr;
+
+/*
+ * Persistent cache for results that do not change while the same modem
+ * firmware is running. Entries are keyed by the name of the command and
+ * stored in one file per modem (by USB serial number) in the cache directory.
+ * The file is discarded when the modem has enumerated again since it was
+ * written, which is checked without talking to the modem.
+ */
+int uqmi_cache_init(const char *dir, const char *device);
+bool uqmi_cache_enabled(void);
+struct blob_attr *uqmi_cache_get(const char *name);
+void uqmi_cache_set(const char *name, struct blob_attr *data);
+void uqmi_cache_clear(void);
+void uqmi_cache_drop(void);
+void uqmi_cache_done(void);
+
+#endif
@@ -27,7 +27,7 @@ static struct {
 	char* puk;
 } dms_req_data;
 
-static void cmd_dms_get_capabilities_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static void dms_decode_capabilities(struct blob_buf *buf, struct qmi_msg *msg)
 {
 	void *t, *networks;
 	int i;
@@ -49,28 +49,33 @@ static void cmd_dms_get_capabilities_cb(struct qmi_dev *qmi, struct qmi_request
 
 	qmi_parse_dms_get_capabilities_response(msg, &res);
 
-	t = blobmsg_open_table(&status, NULL);
+	t = blobmsg_open_table(buf, NULL);
 
-	blobmsg_add_u32(&status, "max_tx_channel_rate", (int32_t) res.data.info.max_tx_channel_rate);
-	blobmsg_add_u32(&status, "max_rx_channel_rate", (int32_t) res.data.info.max_rx_channel_rate);
+	blobmsg_add_u32(buf, "max_tx_channel_rate", (int32_t) res.data.info.max_tx_channel_rate);
+	blobmsg_add_u32(buf, "max_rx_channel_rate", (int32_t) res.data.info.max_rx_channel_rate);
 	if ((int)res.data.info.data_service_capability >= 0 && res.data.info.data_service_capability < ARRAY_SIZE(service_cap))
-		blobmsg_add_string(&status, "data_service", service_cap[res.data.info.data_service_capability]);
+		blobmsg_add_string(buf, "data_service", service_cap[res.data.info.data_service_capability]);
 
 	if(res.data.info.sim_capability == QMI_DMS_SIM_CAPABILITY_NOT_SUPPORTED)
-		blobmsg_add_string(&status, "sim", "not supported");
+		blobmsg_add_string(buf, "sim", "not supported");
 	else if(res.data.info.sim_capability == QMI_DMS_SIM_CAPABILITY_SUPPORTED)
-		blobmsg_add_string(&status, "sim", "supported");
+		blobmsg_add_string(buf, "sim", "supported");
 
-	networks = blobmsg_open_array(&status, "networks");
+	networks = blobmsg_open_array(buf, "networks");
 	for (i = 0; i < res.data.info.radio_interface_list_n; i++) {
 		if ((int)res.data.info.radio_interface_list[i] >= 0 && res.data.info.radio_interface_list[i] < ARRAY_SIZE(radio_cap))
-			blobmsg_add_string(&status, NULL, radio_cap[res.data.info.radio_interface_list[i]]);
+			blobmsg_add_string(buf, NULL, radio_cap[res.data.info.radio_interface_list[i]]);
 		else
-			blobmsg_add_string(&status, NULL, "unknown");
+			blobmsg_add_string(buf, NULL, "unknown");
 	}
-	blobmsg_close_array(&status, networks);
+	blobmsg_close_array(buf, networks);
+
+	blobmsg_close_table(buf, t);
+}
 
-	blobmsg_close_table(&status, t);
+static void cmd_dms_get_capabilities_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	dms_decode_capabilities(&status, msg);
 }
 
 static enum qmi_cmd_result
@@ -100,24 +105,29 @@ static const char *get_pin_status(int status)
 	return res;
 }
 
-static void cmd_dms_get_pin_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static void dms_decode_pin_status(struct blob_buf *buf, struct qmi_msg *msg)
 {
 	struct qmi_dms_uim_get_pin_status_response res;
 	void *c;
 
 	qmi_parse_dms_uim_get_pin_status_response(msg, &res);
-	c = blobmsg_open_table(&status, NULL);
+	c = blobmsg_open_table(buf, NULL);
 	if (res.set.pin1_status) {
-		blobmsg_add_string(&status, "pin1_status", get_pin_status(res.data.pin1_status.current_status));
-		blobmsg_add_u32(&status, "pin1_verify_tries", (int32_t) res.data.pin1_status.verify_retries_left);
-		blobmsg_add_u32(&status, "pin1_unblock_tries", (int32_t) res.data.pin1_status.unblock_retries_left);
+		blobmsg_add_string(buf, "pin1_status", get_pin_status(res.data.pin1_status.current_status));
+		blobmsg_add_u32(buf, "pin1_verify_tries", (int32_t) res.data.pin1_status.verify_retries_left);
+		blobmsg_add_u32(buf, "pin1_unblock_tries", (int32_t) res.data.pin1_status.unblock_retries_left);
 	}
 	if (res.set.pin2_status) {
-		blobmsg_add_string(&status, "pin2_status", get_pin_status(res.data.pin2_status.current_status));
-		blobmsg_add_u32(&status, "pin2_verify_tries", (int32_t) res.data.pin2_status.verify_retries_left);
-		blobmsg_add_u32(&status, "pin2_unblock_tries", (int32_t) res.data.pin2_status.unblock_retries_left);
+		blobmsg_add_string(buf, "pin2_status", get_pin_status(res.data.pin2_status.current_status));
+		blobmsg_add_u32(buf, "pin2_verify_tries", (int32_t) res.data.pin2_status.verify_retries_left);
+		blobmsg_add_u32(buf, "pin2_unblock_tries", (int32_t) res.data.pin2_status.unblock_retries_left);
 	}
-	blobmsg_close_table(&status, c);
+	blobmsg_close_table(buf, c);
+}
+
+static void cmd_dms_get_pin_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	dms_decode_pin_status(&status, msg);
 }
 
 static enum qmi_cmd_result
@@ -304,13 +314,18 @@ cmd_dms_unblock_pin2_prepare(struct qmi_dev *qmi, struct qmi_request *req, struc
 }
 
 
-static void cmd_dms_get_iccid_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static void dms_decode_iccid(struct blob_buf *buf, struct qmi_msg *msg)
 {
 	struct qmi_dms_uim_get_iccid_response res;
 
 	qmi_parse_dms_uim_get_iccid_response(msg, &res);
 	if (res.data.iccid)
-		blobmsg_add_string(&status, NULL, res.data.iccid);
+		blobmsg_add_string(buf, NULL, res.data.iccid);
+}
+
+static void cmd_dms_get_iccid_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	dms_decode_iccid(&status, msg);
 }
 
 static enum qmi_cmd_result
@@ -353,13 +368,18 @@ cmd_dms_get_msisdn_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct
 	return QMI_CMD_REQUEST;
 }
 
-static void cmd_dms_get_imei_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static void dms_decode_imei(struct blob_buf *buf, struct qmi_msg *msg)
 {
 	struct qmi_dms_get_ids_response res;
 
 	qmi_parse_dms_get_ids_response(msg, &res);
 	if (res.data.imei)
-		blobmsg_add_string(&status, NULL, res.data.imei);
+		blobmsg_add_string(buf, NULL, res.data.imei);
+}
+
+static void cmd_dms_get_imei_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	dms_decode_imei(&status, msg);
 }
 
 static enum qmi_cmd_result
@@ -369,6 +389,38 @@ cmd_dms_get_imei_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qm
 	return QMI_CMD_REQUEST;
 }
 
+static void cmd_dms_get_model_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_dms_get_model_response res;
+
+	qmi_parse_dms_get_model_response(msg, &res);
+	if (res.data.model)
+		blobmsg_add_string(&status, NULL, res.data.model);
+}
+
+static enum qmi_cmd_result
+cmd_dms_get_model_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	qmi_set_dms_get_model_request(msg);
+	return QMI_CMD_REQUEST;
+}
+
+static void cmd_dms_get_revision_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_dms_get_revision_response res;
+
+	qmi_parse_dms_get_revision_response(msg, &res);
+	if (res.data.revision)
+		blobmsg_add_string(&status, NULL, res.data.revision);
+}
+
+static enum qmi_cmd_result
+cmd_dms_get_revision_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	qmi_set_dms_get_revision_request(msg);
+	return QMI_CMD_REQUEST;
+}
+
 #define cmd_dms_reset_cb no_cb
 static enum qmi_cmd_result
 cmd_dms_reset_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
@@ -404,6 +456,9 @@ cmd_dms_set_operating_mode_prepare(struct qmi_dev *qmi, struct qmi_request *req,
 			continue;
 
 		sreq.data.mode = i;
+		if (i == QMI_DMS_OPERATING_MODE_RESET)
+			uqmi_cache_drop();
+
 		qmi_set_dms_set_operating_mode_request(msg, &sreq);
 		return QMI_CMD_REQUEST;
 	}
@@ -36,6 +36,8 @@
 	__uqmi_command(dms_get_iccid, get-iccid, no, QMI_SERVICE_DMS), \
 	__uqmi_command(dms_get_imsi, get-imsi, no, QMI_SERVICE_DMS), \
 	__uqmi_command(dms_get_imei, get-imei, no, QMI_SERVICE_DMS), \
+	__uqmi_command(dms_get_model, get-model, no, QMI_SERVICE_DMS), \
+	__uqmi_command(dms_get_revision, get-revision, no, QMI_SERVICE_DMS), \
 	__uqmi_command(dms_get_msisdn, get-msisdn, no, QMI_SERVICE_DMS), \
 	__uqmi_command(dms_set_operating_mode, set-device-operating-mode, required, QMI_SERVICE_DMS), \
 	__uqmi_command(dms_reset, reset-dms, no, QMI_SERVICE_DMS), \
@@ -65,6 +67,8 @@
 		"  --get-iccid:                      Get the ICCID\n" \
 		"  --get-imsi:                       Get International Mobile Subscriber ID\n" \
 		"  --get-imei:                       Get International Mobile Equipment ID\n" \
+		"  --get-model:                      Get the device model\n" \
+		"  --get-revision:                   Get the firmware revision\n" \
 		"  --get-msisdn:                     Get the MSISDN (telephone number)\n" \
 		"  --reset-dms:                      Reset the DMS service\n" \
 		"  --set-device-operating-mode <m>   Set the device operating mode\n" \
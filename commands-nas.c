@@ -193,52 +193,58 @@ cmd_nas_initiate_network_register_prepare(struct qmi_dev *qmi, struct qmi_reques
 }
 
 static void
-cmd_nas_get_signal_info_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+nas_decode_signal_info(struct blob_buf *buf, struct qmi_msg *msg)
 {
 	struct qmi_nas_get_signal_info_response res;
 	void *c;
 
 	qmi_parse_nas_get_signal_info_response(msg, &res);
 
-	c = blobmsg_open_table(&status, NULL);
+	c = blobmsg_open_table(buf, NULL);
 	if (res.set.cdma_signal_strength) {
-		blobmsg_add_string(&status, "type", "cdma");
-		blobmsg_add_u32(&status, "rssi", (int32_t) res.data.cdma_signal_strength.rssi);
-		blobmsg_add_u32(&status, "ecio", (int32_t) res.data.cdma_signal_strength.ecio);
+		blobmsg_add_string(buf, "type", "cdma");
+		blobmsg_add_u32(buf, "rssi", (int32_t) res.data.cdma_signal_strength.rssi);
+		blobmsg_add_u32(buf, "ecio", (int32_t) res.data.cdma_signal_strength.ecio);
 	}
 
 	if (res.set.hdr_signal_strength) {
-		blobmsg_add_string(&status, "type", "hdr");
-		blobmsg_add_u32(&status, "rssi", (int32_t) res.data.hdr_signal_strength.rssi);
-		blobmsg_add_u32(&status, "ecio", (int32_t) res.data.hdr_signal_strength.ecio);
-		blobmsg_add_u32(&status, "io", res.data.hdr_signal_strength.io);
+		blobmsg_add_string(buf, "type", "hdr");
+		blobmsg_add_u32(buf, "rssi", (int32_t) res.data.hdr_signal_strength.rssi);
+		blobmsg_add_u32(buf, "ecio", (int32_t) res.data.hdr_signal_strength.ecio);
+		blobmsg_add_u32(buf, "io", res.data.hdr_signal_strength.io);
 	}
 
 	if (res.set.gsm_signal_strength) {
-		blobmsg_add_string(&status, "type", "gsm");
-		blobmsg_add_u32(&status, "signal", (int32_t) res.data.gsm_signal_strength);
+		blobmsg_add_string(buf, "type", "gsm");
+		blobmsg_add_u32(buf, "signal", (int32_t) res.data.gsm_signal_strength);
 	}
 
 	if (res.set.wcdma_signal_strength) {
-		blobmsg_add_string(&status, "type", "wcdma");
-		blobmsg_add_u32(&status, "rssi", (int32_t) res.data.wcdma_signal_strength.rssi);
-		blobmsg_add_u32(&status, "ecio", (int32_t) res.data.wcdma_signal_strength.ecio);
+		blobmsg_add_string(buf, "type", "wcdma");
+		blobmsg_add_u32(buf, "rssi", (int32_t) res.data.wcdma_signal_strength.rssi);
+		blobmsg_add_u32(buf, "ecio", (int32_t) res.data.wcdma_signal_strength.ecio);
 	}
 
 	if (res.set.lte_signal_strength) {
-		blobmsg_add_string(&status, "type", "lte");
-		blobmsg_add_u32(&status, "rssi", (int32_t) res.data.lte_signal_strength.rssi);
-		blobmsg_add_u32(&status, "rsrq", (int32_t) res.data.lte_signal_strength.rsrq);
-		blobmsg_add_u32(&status, "rsrp", (int32_t) res.data.lte_signal_strength.rsrp);
-		blobmsg_add_u32(&status, "snr", (int32_t) res.data.lte_signal_strength.snr);
+		blobmsg_add_string(buf, "type", "lte");
+		blobmsg_add_u32(buf, "rssi", (int32_t) res.data.lte_signal_strength.rssi);
+		blobmsg_add_u32(buf, "rsrq", (int32_t) res.data.lte_signal_strength.rsrq);
+		blobmsg_add_u32(buf, "rsrp", (int32_t) res.data.lte_signal_strength.rsrp);
+		blobmsg_add_u32(buf, "snr", (int32_t) res.data.lte_signal_strength.snr);
 	}
 
 	if (res.set.tdma_signal_strength) {
-		blobmsg_add_string(&status, "type", "tdma");
-		blobmsg_add_u32(&status, "signal", (int32_t) res.data.tdma_signal_strength);
+		blobmsg_add_string(buf, "type", "tdma");
+		blobmsg_add_u32(buf, "signal", (int32_t) res.data.tdma_signal_strength);
 	}
 
-	blobmsg_close_table(&status, c);
+	blobmsg_close_table(buf, c);
+}
+
+static void
+cmd_nas_get_signal_info_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	nas_decode_signal_info(&status, msg);
 }
 
 static enum qmi_cmd_result
@@ -248,10 +254,8 @@ cmd_nas_get_signal_info_prepare(struct qmi_dev *qmi, struct qmi_request *req, st
 	return QMI_CMD_REQUEST;
 }
 
-static void
-cmd_nas_get_serving_system_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static const char *nas_get_registration_state(int state)
 {
-	struct qmi_nas_get_serving_system_response res;
 	static const char *reg_states[] = {
 		[QMI_NAS_REGISTRATION_STATE_NOT_REGISTERED] = "not_registered",
 		[QMI_NAS_REGISTRATION_STATE_REGISTERED] = "registered",
@@ -259,37 +263,145 @@ cmd_nas_get_serving_system_cb(struct qmi_dev *qmi, struct qmi_request *req, stru
 		[QMI_NAS_REGISTRATION_STATE_REGISTRATION_DENIED] = "registering_denied",
 		[QMI_NAS_REGISTRATION_STATE_UNKNOWN] = "unknown",
 	};
+
+	if (state > QMI_NAS_REGISTRATION_STATE_UNKNOWN)
+		state = QMI_NAS_REGISTRATION_STATE_UNKNOWN;
+
+	return reg_states[state];
+}
+
+static void nas_add_plmn(struct blob_buf *buf, uint16_t mcc, uint16_t mnc, const char *description)
+{
+	blobmsg_add_u32(buf, "plmn_mcc", mcc);
+	blobmsg_add_u32(buf, "plmn_mnc", mnc);
+	if (description)
+		blobmsg_add_string(buf, "plmn_description", description);
+}
+
+static void
+nas_decode_serving_system(struct blob_buf *buf, struct qmi_msg *msg)
+{
+	struct qmi_nas_get_serving_system_response res;
 	void *c;
 
 	qmi_parse_nas_get_serving_system_response(msg, &res);
 
-	c = blobmsg_open_table(&status, NULL);
-	if (res.set.serving_system) {
-		int state = res.data.serving_system.registration_state;
+	c = blobmsg_open_table(buf, NULL);
+	if (res.set.serving_system)
+		blobmsg_add_string(buf, "registration",
+				   nas_get_registration_state(res.data.serving_system.registration_state));
 
-		if (state > QMI_NAS_REGISTRATION_STATE_UNKNOWN)
-			state = QMI_NAS_REGISTRATION_STATE_UNKNOWN;
+	if (res.set.current_plmn)
+		nas_add_plmn(buf, res.data.current_plmn.mcc, res.data.current_plmn.mnc,
+			     res.data.current_plmn.description);
 
-		blobmsg_add_string(&status, "registration", reg_states[state]);
-	}
-	if (res.set.current_plmn) {
-		blobmsg_add_u32(&status, "plmn_mcc", res.data.current_plmn.mcc);
-		blobmsg_add_u32(&status, "plmn_mnc", res.data.current_plmn.mnc);
-		if (res.data.current_plmn.description)
-			blobmsg_add_string(&status, "plmn_description", res.data.current_plmn.description);
-	}
+	if (res.set.roaming_indicator)
+		blobmsg_add_u8(buf, "roaming", !res.data.roaming_indicator);
+
+	blobmsg_close_table(buf, c);
+}
+
+static void
+cmd_nas_get_serving_system_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	nas_decode_serving_system(&status, msg);
+}
+
+static enum qmi_cmd_result
+cmd_nas_get_serving_system_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	qmi_set_nas_get_serving_system_request(msg);
+	return QMI_CMD_REQUEST;
+}
+
+static struct {
+	struct qmi_indication ind;
+	bool registered;
+} nas_wait;
+
+static void
+nas_serving_system_ind_cb(struct qmi_dev *qmi, struct qmi_indication *ind, struct qmi_msg *msg)
+{
+	struct qmi_nas_serving_system_indication res;
+	void *c;
+
+	qmi_parse_nas_serving_system_indication(msg, &res);
+	if (nas_wait.registered || !res.set.serving_system ||
+	    res.data.serving_system.registration_state != QMI_NAS_REGISTRATION_STATE_REGISTERED)
+		return;
+
+	c = blobmsg_open_table(&status, NULL);
+	blobmsg_add_string(&status, "registration",
+			   nas_get_registration_state(res.data.serving_system.registration_state));
+
+	if (res.set.current_plmn)
+		nas_add_plmn(&status, res.data.current_plmn.mcc, res.data.current_plmn.mnc,
+			     res.data.current_plmn.description);
 
 	if (res.set.roaming_indicator)
 		blobmsg_add_u8(&status, "roaming", !res.data.roaming_indicator);
 
 	blobmsg_close_table(&status, c);
+
+	nas_wait.registered = true;
+	uloop_end();
+}
+
+static void
+cmd_nas_wait_registered_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_nas_get_serving_system_response res;
+
+	qmi_parse_nas_get_serving_system_response(msg, &res);
+	if (!res.set.serving_system ||
+	    res.data.serving_system.registration_state != QMI_NAS_REGISTRATION_STATE_REGISTERED)
+		return;
+
+	cmd_nas_get_serving_system_cb(qmi, req, msg);
+	nas_wait.registered = true;
 }
 
 static enum qmi_cmd_result
-cmd_nas_get_serving_system_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+cmd_nas_wait_registered_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
 {
+	static struct qmi_nas_register_indications_request ireq = {
+		QMI_INIT(serving_system_events, true),
+	};
+	char *err;
+	long timeout;
+	int ret;
+
+	timeout = strtol(arg, &err, 10);
+	if ((err && *err) || timeout <= 0 || timeout > INT_MAX / 1000) {
+		uqmi_add_error("Invalid timeout value");
+		return QMI_CMD_EXIT;
+	}
+
+	qmi_indication_register(qmi, &nas_wait.ind, QMI_SERVICE_NAS,
+				QMI_NAS_SERVING_SYSTEM_INDICATION,
+				nas_serving_system_ind_cb);
+
+	/* older firmware sends serving system indications unconditionally */
+	qmi_set_nas_register_indications_request(msg, &ireq);
+	qmi_request_start(qmi, req, NULL);
+	qmi_request_wait(qmi, req);
+
+	/* the device may already be registered, check the current state */
 	qmi_set_nas_get_serving_system_request(msg);
-	return QMI_CMD_REQUEST;
+	qmi_request_start(qmi, req, cmd_nas_wait_registered_cb);
+	req->no_error_cb = true;
+	ret = qmi_request_wait(qmi, req);
+	if (!ret)
+		ret = qmi_device_wait(qmi, &nas_wait.registered, timeout * 1000);
+
+	qmi_indication_unregister(qmi, &nas_wait.ind);
+
+	if (ret == QMI_ERROR_TIMEOUT)
+		return uqmi_add_error("Timeout waiting for network registration");
+	else if (ret)
+		return uqmi_add_error(qmi_get_error_str(ret));
+
+	return QMI_CMD_DONE;
 }
 
 static void
@@ -30,6 +30,7 @@
 	__uqmi_command(nas_network_scan, network-scan, no, QMI_SERVICE_NAS), \
 	__uqmi_command(nas_get_signal_info, get-signal-info, no, QMI_SERVICE_NAS), \
 	__uqmi_command(nas_get_serving_system, get-serving-system, no, QMI_SERVICE_NAS), \
+	__uqmi_command(nas_wait_registered, wait-registered, required, QMI_SERVICE_NAS), \
 	__uqmi_command(nas_set_network_preference, set-network-preference, required, CMD_TYPE_OPTION), \
 	__uqmi_command(nas_set_roaming, set-network-roaming, required, CMD_TYPE_OPTION), \
 	__uqmi_command(nas_get_home_network, get-home-network, no, QMI_SERVICE_NAS)\
@@ -49,5 +50,6 @@
 		"  --get-plmn:                       Get preferred network selection info\n" \
 		"  --get-signal-info:                Get signal strength info\n" \
 		"  --get-serving-system:             Get serving system info\n" \
+		"  --wait-registered <timeout>:      Wait up to <timeout> seconds for network registration\n" \
 		"  --get-home-network:				 Get Home network info\n"
 
@@ -576,7 +576,7 @@ static const char *qmi_uim_get_personalization_feature_string(int status) {
 	return res;
 }
 
-static void cmd_uim_get_card_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static void uim_decode_card_status(struct blob_buf *buf, struct qmi_msg *msg)
 {
 	struct qmi_uim_get_card_status_response res;
 	void *c, *slots, *slot, *application, *applications, *pin1, *pin2;
@@ -584,62 +584,67 @@ static void cmd_uim_get_card_status_cb(struct qmi_dev *qmi, struct qmi_request *
 
 	qmi_parse_uim_get_card_status_response(msg, &res);
 
-	c = blobmsg_open_table(&status, NULL);
-	slots = blobmsg_open_array(&status, "slots");
+	c = blobmsg_open_table(buf, NULL);
+	slots = blobmsg_open_array(buf, "slots");
 
 	if (res.set.card_status) {
 		for (int i = 0; i < res.data.card_status.cards_n; i++) {
-			slot = blobmsg_open_table(&status, NULL);
-			blobmsg_add_u32(&status, "Slot ", (int32_t) i + 1);
+			slot = blobmsg_open_table(buf, NULL);
+			blobmsg_add_u32(buf, "Slot ", (int32_t) i + 1);
 			state = res.data.card_status.cards[i].card_state;
 			if (state != QMI_UIM_CARD_STATE_ERROR)
-				blobmsg_add_string(&status, "Card State", qmi_uim_get_card_status(state));
+				blobmsg_add_string(buf, "Card State", qmi_uim_get_card_status(state));
 			else
-				blobmsg_add_string(&status, "Card Error", qmi_uim_get_card_error_string(state));
-			blobmsg_add_string(&status, "UPIN State", qmi_uim_get_pin_status(res.data.card_status.cards[i].upin_state));
-			blobmsg_add_u32(&status, "UPIN retries", (int32_t) res.data.card_status.cards[i].upin_retries);
-			blobmsg_add_u32(&status, "UPUK retries", (int32_t) res.data.card_status.cards[i].upuk_retries);
+				blobmsg_add_string(buf, "Card Error", qmi_uim_get_card_error_string(state));
+			blobmsg_add_string(buf, "UPIN State", qmi_uim_get_pin_status(res.data.card_status.cards[i].upin_state));
+			blobmsg_add_u32(buf, "UPIN retries", (int32_t) res.data.card_status.cards[i].upin_retries);
+			blobmsg_add_u32(buf, "UPUK retries", (int32_t) res.data.card_status.cards[i].upuk_retries);
 
-			applications = blobmsg_open_array(&status, "applications");
+			applications = blobmsg_open_array(buf, "applications");
 
 			for (int j = 0; j < res.data.card_status.cards->applications_n; j++) {
-				application = blobmsg_open_table(&status, NULL);
-				blobmsg_add_u32(&status, "Application", (int32_t) j + 1);
-				blobmsg_add_string(&status, "Application type", qmi_uim_get_application_type_string(res.data.card_status.cards[i].applications[j].type));
-				blobmsg_add_string(&status, "Application state", qmi_uim_get_application_state_string(res.data.card_status.cards[i].applications[j].state));
-				blobmsg_add_string(&status, "Application ID", read_raw_data(res.data.card_status.cards[i].applications[i].application_identifier_value_n, res.data.card_status.cards[i].applications[j].application_identifier_value, false));
+				application = blobmsg_open_table(buf, NULL);
+				blobmsg_add_u32(buf, "Application", (int32_t) j + 1);
+				blobmsg_add_string(buf, "Application type", qmi_uim_get_application_type_string(res.data.card_status.cards[i].applications[j].type));
+				blobmsg_add_string(buf, "Application state", qmi_uim_get_application_state_string(res.data.card_status.cards[i].applications[j].state));
+				blobmsg_add_string(buf, "Application ID", read_raw_data(res.data.card_status.cards[i].applications[i].application_identifier_value_n, res.data.card_status.cards[i].applications[j].application_identifier_value, false));
 				if (res.data.card_status.cards[i].applications[j].personalization_state == QMI_UIM_CARD_APPLICATION_PERSONALIZATION_STATE_CODE_REQUIRED ||
 					res.data.card_status.cards[i].applications[j].personalization_state == QMI_UIM_CARD_APPLICATION_PERSONALIZATION_STATE_PUK_CODE_REQUIRED) {
-					blobmsg_add_string(&status, "Personalization state", qmi_uim_get_personalization_state_string(res.data.card_status.cards[i].applications[j].personalization_state));
-					blobmsg_add_string(&status, "Personalization feature", qmi_uim_get_personalization_feature_string(res.data.card_status.cards[i].applications[j].personalization_feature));
-					blobmsg_add_u32(&status, "Disable retries", (int32_t) res.data.card_status.cards[i].applications[j].personalization_retries);
-					blobmsg_add_u32(&status, "Unblock retries", (int32_t) res.data.card_status.cards[i].applications[j].personalization_unblock_retries);
+					blobmsg_add_string(buf, "Personalization state", qmi_uim_get_personalization_state_string(res.data.card_status.cards[i].applications[j].personalization_state));
+					blobmsg_add_string(buf, "Personalization feature", qmi_uim_get_personalization_feature_string(res.data.card_status.cards[i].applications[j].personalization_feature));
+					blobmsg_add_u32(buf, "Disable retries", (int32_t) res.data.card_status.cards[i].applications[j].personalization_retries);
+					blobmsg_add_u32(buf, "Unblock retries", (int32_t) res.data.card_status.cards[i].applications[j].personalization_unblock_retries);
 					}
 				else {
-					blobmsg_add_string(&status, "Personalization state", qmi_uim_get_personalization_state_string(res.data.card_status.cards[i].applications[j].personalization_state));
+					blobmsg_add_string(buf, "Personalization state", qmi_uim_get_personalization_state_string(res.data.card_status.cards[i].applications[j].personalization_state));
 				}
-				blobmsg_add_string(&status, "UPIN replaces PIN1", res.data.card_status.cards[i].applications[j].upin_replaces_pin1 ? "yes" : "no");
+				blobmsg_add_string(buf, "UPIN replaces PIN1", res.data.card_status.cards[i].applications[j].upin_replaces_pin1 ? "yes" : "no");
 
-				blobmsg_add_string(&status, "PIN1 state", qmi_uim_get_pin_status(res.data.card_status.cards[i].applications[j].pin1_state));
-				pin1 = blobmsg_open_table(&status, NULL);
-				blobmsg_add_u32(&status, "PIN1 retries", (int32_t) res.data.card_status.cards[i].applications[j].pin1_retries);
-				blobmsg_add_u32(&status, "PUK1 retries", (int32_t) res.data.card_status.cards[i].applications[j].puk1_retries);
-				blobmsg_close_table(&status, pin1);
+				blobmsg_add_string(buf, "PIN1 state", qmi_uim_get_pin_status(res.data.card_status.cards[i].applications[j].pin1_state));
+				pin1 = blobmsg_open_table(buf, NULL);
+				blobmsg_add_u32(buf, "PIN1 retries", (int32_t) res.data.card_status.cards[i].applications[j].pin1_retries);
+				blobmsg_add_u32(buf, "PUK1 retries", (int32_t) res.data.card_status.cards[i].applications[j].puk1_retries);
+				blobmsg_close_table(buf, pin1);
 
-				blobmsg_add_string(&status, "PIN2 state", qmi_uim_get_pin_status(res.data.card_status.cards[i].applications[j].pin2_state));
-				pin2 = blobmsg_open_table(&status, NULL);
-				blobmsg_add_u32(&status, "PIN2 retries", (int32_t) res.data.card_status.cards[i].applications[j].pin2_retries);
-				blobmsg_add_u32(&status, "PUK2 retries", (int32_t) res.data.card_status.cards[i].applications[j].puk2_retries);
-				blobmsg_close_table(&status, pin2);
+				blobmsg_add_string(buf, "PIN2 state", qmi_uim_get_pin_status(res.data.card_status.cards[i].applications[j].pin2_state));
+				pin2 = blobmsg_open_table(buf, NULL);
+				blobmsg_add_u32(buf, "PIN2 retries", (int32_t) res.data.card_status.cards[i].applications[j].pin2_retries);
+				blobmsg_add_u32(buf, "PUK2 retries", (int32_t) res.data.card_status.cards[i].applications[j].puk2_retries);
+				blobmsg_close_table(buf, pin2);
 
-				blobmsg_close_table(&status, application);
+				blobmsg_close_table(buf, application);
 			}
-			blobmsg_close_array(&status, applications);
-			blobmsg_close_table(&status, slot);
+			blobmsg_close_array(buf, applications);
+			blobmsg_close_table(buf, slot);
 		}
-		blobmsg_close_array(&status, slots);
+		blobmsg_close_array(buf, slots);
 	}
-	blobmsg_close_table(&status, c);
+	blobmsg_close_table(buf, c);
+}
+
+static void cmd_uim_get_card_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	uim_decode_card_status(&status, msg);
 }
 
 static enum qmi_cmd_result
@@ -687,4 +692,176 @@ cmd_uim_get_pin1_info_prepare(struct qmi_dev *qmi, struct qmi_request *req, stru
 {
 	qmi_set_uim_get_card_status_request(msg);
 	return QMI_CMD_REQUEST;
-}
\ No newline at end of file
+}
+
+enum uim_wait_state {
+	UIM_WAIT_PENDING,
+	UIM_WAIT_READY,
+	UIM_WAIT_FAILED,
+};
+
+static struct {
+	struct qmi_indication ind;
+	enum uim_wait_state state;
+	int app_state;
+	bool changed;
+	bool complete;
+} uim_wait;
+
+static void uim_check_application_state(int state)
+{
+	switch (state) {
+	case QMI_UIM_CARD_APPLICATION_STATE_READY:
+		uim_wait.state = UIM_WAIT_READY;
+		break;
+	case QMI_UIM_CARD_APPLICATION_STATE_PIN1_OR_UPIN_PIN_REQUIRED:
+	case QMI_UIM_CARD_APPLICATION_STATE_PUK1_OR_UPIN_PUK_REQUIRED:
+	case QMI_UIM_CARD_APPLICATION_STATE_PIN1_BLOCKED:
+	case QMI_UIM_CARD_APPLICATION_STATE_ILLEGAL:
+		if (uim_wait.state == UIM_WAIT_READY)
+			break;
+
+		/* user action is required, waiting any longer is pointless */
+		uim_wait.state = UIM_WAIT_FAILED;
+		uim_wait.app_state = state;
+		break;
+	default:
+		/* detected, initializing, checking personalization, ... */
+		break;
+	}
+}
+
+static void
+uim_update_wait_state(const struct qmi_uim_get_card_status_response *res)
+{
+	int i, j;
+
+	uim_wait.state = UIM_WAIT_PENDING;
+	for (i = 0; i < res->data.card_status.cards_n; i++) {
+		if (res->data.card_status.cards[i].card_state != QMI_UIM_CARD_STATE_PRESENT)
+			continue;
+
+		for (j = 0; j < res->data.card_status.cards[i].applications_n; j++)
+			uim_check_application_state(res->data.card_status.cards[i].applications[j].state);
+	}
+}
+
+/*
+ * The indication carries the card status in a generated struct of its own,
+ * only use it as a trigger to query the status again.
+ */
+static void
+uim_card_status_ind_cb(struct qmi_dev *qmi, struct qmi_indication *ind, struct qmi_msg *msg)
+{
+	uim_wait.changed = true;
+	uloop_end();
+}
+
+static void
+uim_wait_card_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_uim_get_card_status_response res;
+
+	qmi_parse_uim_get_card_status_response(msg, &res);
+	if (!res.set.card_status)
+		return;
+
+	uim_update_wait_state(&res);
+	if (uim_wait.state != UIM_WAIT_PENDING)
+		uim_wait.complete = true;
+}
+
+static int
+uim_wait_get_card_status(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	qmi_set_uim_get_card_status_request(msg);
+	qmi_request_start(qmi, req, uim_wait_card_status_cb);
+	req->no_error_cb = true;
+	return qmi_request_wait(qmi, req);
+}
+
+#define UIM_WAIT_POLL_MIN	100
+#define UIM_WAIT_POLL_MAX	2000
+
+#define cmd_uim_wait_ready_cb no_cb
+static enum qmi_cmd_result
+cmd_uim_wait_ready_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	static struct qmi_uim_register_events_request ereq = {
+		QMI_INIT(event_registration_mask, QMI_UIM_EVENT_REGISTRATION_FLAG_CARD_STATUS),
+	};
+	struct timespec start, now;
+	int delay = UIM_WAIT_POLL_MIN;
+	bool indications;
+	bool never = false;
+	char *err;
+	long timeout;
+	int elapsed;
+	int ret;
+
+	timeout = strtol(arg, &err, 10);
+	if ((err && *err) || timeout <= 0 || timeout > INT_MAX / 1000) {
+		uqmi_add_error("Invalid timeout value");
+		return QMI_CMD_EXIT;
+	}
+	timeout *= 1000;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	qmi_indication_register(qmi, &uim_wait.ind, QMI_SERVICE_UIM,
+				QMI_UIM_CARD_STATUS_INDICATION,
+				uim_card_status_ind_cb);
+
+	qmi_set_uim_register_events_request(msg, &ereq);
+	qmi_request_start(qmi, req, NULL);
+	req->no_error_cb = true;
+	indications = !qmi_request_wait(qmi, req);
+
+	while (1) {
+		/* the card status request may fail while the SIM is initializing */
+		uim_wait.changed = false;
+		ret = uim_wait_get_card_status(qmi, req, msg);
+		if (ret < 0 || uim_wait.complete)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - start.tv_sec) * 1000 +
+			  (now.tv_nsec - start.tv_nsec) / 1000000;
+		if (elapsed >= timeout) {
+			ret = QMI_ERROR_TIMEOUT;
+			break;
+		}
+
+		if (indications) {
+			ret = qmi_device_wait(qmi, &uim_wait.changed, timeout - elapsed);
+			if (ret)
+				break;
+			continue;
+		}
+
+		/* no card status indications on this firmware, poll with backoff */
+		if (delay > timeout - elapsed)
+			delay = timeout - elapsed;
+
+		ret = qmi_device_wait(qmi, &never, delay);
+		if (ret != QMI_ERROR_TIMEOUT)
+			break;
+
+		delay *= 2;
+		if (delay > UIM_WAIT_POLL_MAX)
+			delay = UIM_WAIT_POLL_MAX;
+	}
+
+	qmi_indication_unregister(qmi, &uim_wait.ind);
+
+	if (ret == QMI_ERROR_TIMEOUT)
+		return uqmi_add_error("Timeout waiting for SIM card");
+	else if (ret)
+		return uqmi_add_error(qmi_get_error_str(ret));
+
+	if (uim_wait.state == UIM_WAIT_FAILED)
+		return uqmi_add_error(qmi_uim_get_application_state_string(uim_wait.app_state));
+
+	blobmsg_add_string(&status, NULL, qmi_uim_get_application_state_string(QMI_UIM_CARD_APPLICATION_STATE_READY));
+	return QMI_CMD_DONE;
+}
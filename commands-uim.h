@@ -32,6 +32,7 @@
 	__uqmi_command(uim_change_pin2, uim-change-pin2, no, QMI_SERVICE_UIM), \
 	__uqmi_command(uim_set_new_pin, uim-new-pin, required, CMD_TYPE_OPTION), \
 	__uqmi_command(uim_get_card_status, uim-get-card-status, no, QMI_SERVICE_UIM), \
+	__uqmi_command(uim_wait_ready, uim-wait-ready, required, QMI_SERVICE_UIM), \
 	__uqmi_command(uim_get_pin1_info, uim-get-pin1-info, no, QMI_SERVICE_UIM) \
 
 
@@ -52,4 +53,5 @@
 		"    --uim-pin <old pin>:                 Current PIN2\n" \
 		"    --uim-new-pin <new pin>:             New pin\n" \
 		"  --uim-get-card-status:				  Get Card Status\n" \
+		"  --uim-wait-ready <timeout>:       Wait up to <timeout> seconds for the SIM application to become ready\n" \
 		"  --uim-get-pin1-info: 				Get information about PIN1\n"
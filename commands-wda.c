@@ -31,21 +31,197 @@ static const struct {
 	{ "raw-ip", QMI_WDA_LINK_LAYER_PROTOCOL_RAW_IP },
 };
 
+static const struct {
+	const char *name;
+	QmiWdaDataAggregationProtocol val;
+} aggregation_modes[] = {
+	{ "disabled", QMI_WDA_DATA_AGGREGATION_PROTOCOL_DISABLED },
+	{ "tlp", QMI_WDA_DATA_AGGREGATION_PROTOCOL_TLP },
+	{ "qc-ncm", QMI_WDA_DATA_AGGREGATION_PROTOCOL_QC_NCM },
+	{ "mbim", QMI_WDA_DATA_AGGREGATION_PROTOCOL_MBIM },
+	{ "rndis", QMI_WDA_DATA_AGGREGATION_PROTOCOL_RNDIS },
+	{ "qmap", QMI_WDA_DATA_AGGREGATION_PROTOCOL_QMAP },
+};
+
+static struct qmi_wda_set_data_format_request wda_df_req;
+static bool wda_df_aggregation;
+
+static const char *wda_get_link_mode(int val)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(link_modes); i++) {
+		if (link_modes[i].val == val)
+			return link_modes[i].name;
+	}
+
+	return "unknown";
+}
+
+static const char *wda_get_aggregation_mode(int val)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(aggregation_modes); i++) {
+		if (aggregation_modes[i].val == val)
+			return aggregation_modes[i].name;
+	}
+
+	return "unknown";
+}
+
+#define cmd_wda_set_aggregation_cb no_cb
+static enum qmi_cmd_result
+cmd_wda_set_aggregation_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(aggregation_modes); i++) {
+		if (strcasecmp(aggregation_modes[i].name, arg) != 0)
+			continue;
+
+		qmi_set(&wda_df_req, uplink_data_aggregation_protocol, aggregation_modes[i].val);
+		qmi_set(&wda_df_req, downlink_data_aggregation_protocol, aggregation_modes[i].val);
+		wda_df_aggregation = true;
+		return QMI_CMD_DONE;
+	}
+
+	uqmi_add_error("Invalid aggregation mode (valid: disabled, tlp, qc-ncm, mbim, rndis, qmap)");
+	return QMI_CMD_EXIT;
+}
+
+#define cmd_wda_set_dl_max_datagrams_cb no_cb
+static enum qmi_cmd_result
+cmd_wda_set_dl_max_datagrams_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	char *err;
+	long long val = strtoll(arg, &err, 10);
+
+	if (!*arg || *err || val <= 0 || val > UINT32_MAX) {
+		uqmi_add_error("Invalid datagram count");
+		return QMI_CMD_EXIT;
+	}
+
+	qmi_set(&wda_df_req, downlink_data_aggregation_max_datagrams, val);
+	wda_df_aggregation = true;
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wda_set_dl_max_size_cb no_cb
+static enum qmi_cmd_result
+cmd_wda_set_dl_max_size_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	char *err;
+	long long val = strtoll(arg, &err, 10);
+
+	if (!*arg || *err || val <= 0 || val > UINT32_MAX) {
+		uqmi_add_error("Invalid aggregation size");
+		return QMI_CMD_EXIT;
+	}
+
+	qmi_set(&wda_df_req, downlink_data_aggregation_max_size, val);
+	wda_df_aggregation = true;
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wda_set_qos_format_cb no_cb
+static enum qmi_cmd_result
+cmd_wda_set_qos_format_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	qmi_set(&wda_df_req, qos_format, true);
+	return QMI_CMD_DONE;
+}
+
+static void
+cmd_wda_get_data_format_details_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wda_get_data_format_response res;
+	void *c;
+
+	qmi_parse_wda_get_data_format_response(msg, &res);
+
+	c = blobmsg_open_table(&status, NULL);
+	if (res.set.link_layer_protocol)
+		blobmsg_add_string(&status, "link-layer-protocol",
+				   wda_get_link_mode(res.data.link_layer_protocol));
+	if (res.set.qos_format)
+		blobmsg_add_u8(&status, "qos-format", res.data.qos_format);
+	if (res.set.uplink_data_aggregation_protocol)
+		blobmsg_add_string(&status, "uplink-aggregation-protocol",
+				   wda_get_aggregation_mode(res.data.uplink_data_aggregation_protocol));
+	if (res.set.uplink_data_aggregation_max_datagrams)
+		blobmsg_add_u32(&status, "uplink-max-datagrams",
+				res.data.uplink_data_aggregation_max_datagrams);
+	if (res.set.uplink_data_aggregation_max_size)
+		blobmsg_add_u32(&status, "uplink-max-size",
+				res.data.uplink_data_aggregation_max_size);
+	if (res.set.downlink_data_aggregation_protocol)
+		blobmsg_add_string(&status, "downlink-aggregation-protocol",
+				   wda_get_aggregation_mode(res.data.downlink_data_aggregation_protocol));
+	if (res.set.downlink_data_aggregation_max_datagrams)
+		blobmsg_add_u32(&status, "downlink-max-datagrams",
+				res.data.downlink_data_aggregation_max_datagrams);
+	if (res.set.downlink_data_aggregation_max_size)
+		blobmsg_add_u32(&status, "downlink-max-size",
+				res.data.downlink_data_aggregation_max_size);
+	blobmsg_close_table(&status, c);
+}
+
+static enum qmi_cmd_result
+cmd_wda_get_data_format_details_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	qmi_set_wda_get_data_format_request(msg);
+	return QMI_CMD_REQUEST;
+}
+
+static int wda_apply_data_format(struct qmi_dev *qmi, struct qmi_msg *msg)
+{
+	struct qmi_request req;
+	int ret;
+
+	if (!wda_df_req.set.link_layer_protocol)
+		return 0;
+
+	ret = qmi_service_connect(qmi, QMI_SERVICE_WDA, -1);
+	if (ret)
+		return ret;
+
+	qmi_set_wda_set_data_format_request(msg, &wda_df_req);
+	qmi_request_start(qmi, &req, NULL);
+	return qmi_request_wait(qmi, &req);
+}
+
 #define cmd_wda_set_data_format_cb no_cb
 
 static enum qmi_cmd_result
 cmd_wda_set_data_format_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
 {
-	struct qmi_wda_set_data_format_request data_req = {};
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(link_modes); i++) {
 		if (strcasecmp(link_modes[i].name, arg) != 0)
 			continue;
 
-		qmi_set(&data_req, link_layer_protocol, link_modes[i].val);
-		qmi_set_wda_set_data_format_request(msg, &data_req);
-		return QMI_CMD_REQUEST;
+		qmi_set(&wda_df_req, link_layer_protocol, link_modes[i].val);
+		qmi_set_wda_set_data_format_request(msg, &wda_df_req);
+		if (!wda_df_aggregation)
+			return QMI_CMD_REQUEST;
+
+		/*
+		 * The modem may grant smaller aggregation limits than
+		 * requested, report what it actually uses.
+		 */
+		qmi_request_start(qmi, req, NULL);
+		if (qmi_request_wait(qmi, req))
+			return uqmi_add_error(qmi_get_error_str(req->ret));
+
+		qmi_set_wda_get_data_format_request(msg);
+		qmi_request_start(qmi, req, cmd_wda_get_data_format_details_cb);
+		req->no_error_cb = true;
+		if (qmi_request_wait(qmi, req))
+			return uqmi_add_error(qmi_get_error_str(req->ret));
+
+		return QMI_CMD_DONE;
 	}
 
 	uqmi_add_error("Invalid auth mode (valid: 802.3, raw-ip)");
@@ -56,19 +232,9 @@ static void
 cmd_wda_get_data_format_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
 {
 	struct qmi_wda_get_data_format_response res;
-	const char *name = "unknown";
-	int i;
 
 	qmi_parse_wda_get_data_format_response(msg, &res);
-	for (i = 0; i < ARRAY_SIZE(link_modes); i++) {
-		if (link_modes[i].val != res.data.link_layer_protocol)
-			continue;
-
-		name = link_modes[i].name;
-		break;
-	}
-
-	blobmsg_add_string(&status, NULL, name);
+	blobmsg_add_string(&status, NULL, wda_get_link_mode(res.data.link_layer_protocol));
 }
 
 static enum qmi_cmd_result
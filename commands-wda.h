@@ -21,10 +21,21 @@
 
 #define __uqmi_wda_commands \
 	__uqmi_command(wda_set_data_format, wda-set-data-format, required, QMI_SERVICE_WDA), \
-	__uqmi_command(wda_get_data_format, wda-get-data-format, no, QMI_SERVICE_WDA)
+	__uqmi_command(wda_set_aggregation, wda-aggregation, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wda_set_dl_max_datagrams, wda-dl-max-datagrams, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wda_set_dl_max_size, wda-dl-max-size, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wda_set_qos_format, wda-qos-format, no, CMD_TYPE_OPTION), \
+	__uqmi_command(wda_get_data_format, wda-get-data-format, no, QMI_SERVICE_WDA), \
+	__uqmi_command(wda_get_data_format_details, wda-get-data-format-details, no, QMI_SERVICE_WDA)
 
 
 #define wda_helptext \
 		"  --wda-set-data-format <type>:     Set data format (type: 802.3|raw-ip)\n" \
+		"                                    (prints the granted data format when aggregation is set)\n" \
+		"    --wda-aggregation <mode>:       Uplink and downlink aggregation (disabled, tlp, qc-ncm, mbim, rndis, qmap)\n" \
+		"    --wda-dl-max-datagrams <n>:     Maximum number of datagrams per downlink aggregate\n" \
+		"    --wda-dl-max-size <bytes>:      Maximum size of a downlink aggregate\n" \
+		"    --wda-qos-format:               Enable the QoS header\n" \
 		"  --wda-get-data-format:            Get data format\n" \
+		"  --wda-get-data-format-details:    Get link layer protocol, QoS format and aggregation parameters\n" \
 
@@ -19,16 +19,25 @@
  * Boston, MA 02110-1301 USA.
  */
 
+#include <errno.h>
 #include <stdlib.h>
+#include <time.h>
 #include <arpa/inet.h>
+#include <net/if.h>
 
 #include "qmi-message.h"
+#include "qmi-errors.h"
+#include "netlink.h"
 
 static struct qmi_wds_start_network_request wds_sn_req = {
 	QMI_INIT(authentication_preference,
 	         QMI_WDS_AUTHENTICATION_PAP | QMI_WDS_AUTHENTICATION_CHAP),
 };
 static struct qmi_wds_stop_network_request wds_stn_req;
+static bool wds_dual_stack;
+
+static enum qmi_cmd_result
+wds_start_network_dual_stack(struct qmi_dev *qmi, struct qmi_msg *msg);
 
 #define cmd_wds_set_apn_cb no_cb
 static enum qmi_cmd_result
@@ -104,15 +113,21 @@ cmd_wds_set_ip_family_pref_prepare(struct qmi_dev *qmi, struct qmi_request *req,
 	};
 	int i;
 
+	if (!strcasecmp(arg, "ipv4v6")) {
+		wds_dual_stack = true;
+		return QMI_CMD_DONE;
+	}
+
 	for (i = 0; i < ARRAY_SIZE(modes); i++) {
 		if (strcasecmp(modes[i].name, arg) != 0)
 			continue;
 
 		qmi_set(&wds_sn_req, ip_family_preference, modes[i].mode);
+		wds_dual_stack = false;
 		return QMI_CMD_DONE;
 	}
 
-	uqmi_add_error("Invalid value (valid: ipv4, ipv6, unspecified)");
+	uqmi_add_error("Invalid value (valid: ipv4, ipv6, ipv4v6, unspecified)");
 	return QMI_CMD_EXIT;
 }
 
@@ -139,6 +154,9 @@ cmd_wds_start_network_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qm
 static enum qmi_cmd_result
 cmd_wds_start_network_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
 {
+	if (wds_dual_stack)
+		return wds_start_network_dual_stack(qmi, msg);
+
 	qmi_set_wds_start_network_request(msg, &wds_sn_req);
 	return QMI_CMD_REQUEST;
 }
@@ -154,25 +172,39 @@ cmd_wds_stop_network_prepare(struct qmi_dev *qmi, struct qmi_request *req, struc
 	return QMI_CMD_REQUEST;
 }
 
-static void
-cmd_wds_get_packet_service_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static const char *wds_get_connection_status(int s)
 {
-	struct qmi_wds_get_packet_service_status_response res;
-	const char *data_status[] = {
+	static const char *data_status[] = {
 		[QMI_WDS_CONNECTION_STATUS_UNKNOWN] = "unknown",
 		[QMI_WDS_CONNECTION_STATUS_DISCONNECTED] = "disconnected",
 		[QMI_WDS_CONNECTION_STATUS_CONNECTED] = "connected",
 		[QMI_WDS_CONNECTION_STATUS_SUSPENDED] = "suspended",
 		[QMI_WDS_CONNECTION_STATUS_AUTHENTICATING] = "authenticating",
 	};
+
+	if (s < 0 || s >= ARRAY_SIZE(data_status))
+		s = QMI_WDS_CONNECTION_STATUS_UNKNOWN;
+
+	return data_status[s];
+}
+
+static void
+wds_decode_packet_service_status(struct blob_buf *buf, struct qmi_msg *msg)
+{
+	struct qmi_wds_get_packet_service_status_response res;
 	int s = 0;
 
 	qmi_parse_wds_get_packet_service_status_response(msg, &res);
-	if (res.set.connection_status &&
-	    res.data.connection_status < ARRAY_SIZE(data_status))
+	if (res.set.connection_status)
 		s = res.data.connection_status;
 
-	blobmsg_add_string(&status, NULL, data_status[s]);
+	blobmsg_add_string(buf, NULL, wds_get_connection_status(s));
+}
+
+static void
+cmd_wds_get_packet_service_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	wds_decode_packet_service_status(&status, msg);
 }
 
 static enum qmi_cmd_result
@@ -182,6 +214,133 @@ cmd_wds_get_packet_service_status_prepare(struct qmi_dev *qmi, struct qmi_reques
 	return QMI_CMD_REQUEST;
 }
 
+static const char *wds_get_verbose_call_end_reason_type(int type)
+{
+	static const char *types[] = {
+		[QMI_WDS_VERBOSE_CALL_END_REASON_TYPE_MIP] = "mip",
+		[QMI_WDS_VERBOSE_CALL_END_REASON_TYPE_INTERNAL] = "internal",
+		[QMI_WDS_VERBOSE_CALL_END_REASON_TYPE_CM] = "cm",
+		[QMI_WDS_VERBOSE_CALL_END_REASON_TYPE_3GPP] = "3gpp",
+		[QMI_WDS_VERBOSE_CALL_END_REASON_TYPE_PPP] = "ppp",
+		[QMI_WDS_VERBOSE_CALL_END_REASON_TYPE_EHRPD] = "ehrpd",
+		[QMI_WDS_VERBOSE_CALL_END_REASON_TYPE_IPV6] = "ipv6",
+	};
+
+	if (type < 0 || type >= ARRAY_SIZE(types) || !types[type])
+		return "unknown";
+
+	return types[type];
+}
+
+static struct {
+	struct qmi_indication ind;
+	bool watch;
+	bool complete;
+} wds_status_wait;
+
+static void
+wds_add_packet_service_status(struct qmi_wds_packet_service_status_indication *res)
+{
+	void *v;
+
+	blobmsg_add_string(&status, "status",
+			   wds_get_connection_status(res->data.connection_status.status));
+	blobmsg_add_u8(&status, "reconfiguration_required",
+		       res->data.connection_status.reconfiguration_required);
+
+	if (res->set.ip_family)
+		blobmsg_add_string(&status, "ip-family",
+				   res->data.ip_family == QMI_WDS_IP_FAMILY_IPV6 ? "ipv6" : "ipv4");
+
+	if (res->set.call_end_reason)
+		blobmsg_add_u32(&status, "call_end_reason", res->data.call_end_reason);
+
+	if (res->set.verbose_call_end_reason) {
+		v = blobmsg_open_table(&status, "verbose_call_end_reason");
+		blobmsg_add_string(&status, "type",
+				   wds_get_verbose_call_end_reason_type(res->data.verbose_call_end_reason.type));
+		blobmsg_add_u32(&status, "reason", (int32_t) res->data.verbose_call_end_reason.reason);
+		blobmsg_close_table(&status, v);
+	}
+}
+
+static void
+wds_packet_service_status_ind_cb(struct qmi_dev *qmi, struct qmi_indication *ind, struct qmi_msg *msg)
+{
+	struct qmi_wds_packet_service_status_indication res;
+	int s;
+	void *c;
+
+	qmi_parse_wds_packet_service_status_indication(msg, &res);
+	if (!res.set.connection_status)
+		return;
+
+	s = res.data.connection_status.status;
+	if (!wds_status_wait.watch &&
+	    s != QMI_WDS_CONNECTION_STATUS_CONNECTED &&
+	    s != QMI_WDS_CONNECTION_STATUS_DISCONNECTED)
+		return;
+
+	c = blobmsg_open_table(&status, NULL);
+	wds_add_packet_service_status(&res);
+	blobmsg_close_table(&status, c);
+
+	if (wds_status_wait.watch) {
+		uqmi_flush_result();
+		return;
+	}
+
+	wds_status_wait.complete = true;
+	uloop_end();
+}
+
+static int
+wds_wait_packet_service_status(struct qmi_dev *qmi, int timeout)
+{
+	int ret;
+
+	qmi_indication_register(qmi, &wds_status_wait.ind, QMI_SERVICE_WDS,
+				QMI_WDS_PACKET_SERVICE_STATUS_INDICATION,
+				wds_packet_service_status_ind_cb);
+	ret = qmi_device_wait(qmi, &wds_status_wait.complete, timeout);
+	qmi_indication_unregister(qmi, &wds_status_wait.ind);
+
+	return ret;
+}
+
+#define cmd_wds_wait_data_status_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_wait_data_status_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	char *err;
+	long timeout;
+	int ret;
+
+	timeout = strtol(arg, &err, 10);
+	if ((err && *err) || timeout <= 0 || timeout > INT_MAX / 1000) {
+		uqmi_add_error("Invalid timeout value");
+		return QMI_CMD_EXIT;
+	}
+
+	ret = wds_wait_packet_service_status(qmi, timeout * 1000);
+	if (ret == QMI_ERROR_TIMEOUT)
+		return uqmi_add_error("Timeout waiting for data status change");
+	else if (ret)
+		return uqmi_add_error(qmi_get_error_str(ret));
+
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wds_watch_data_status_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_watch_data_status_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	wds_status_wait.watch = true;
+	wds_wait_packet_service_status(qmi, -1);
+
+	return QMI_CMD_DONE;
+}
+
 #define cmd_wds_set_autoconnect_setting_cb no_cb
 static enum qmi_cmd_result
 cmd_wds_set_autoconnect_setting_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
@@ -243,32 +402,32 @@ cmd_wds_set_ip_family_prepare(struct qmi_dev *qmi, struct qmi_request *req, stru
 	return QMI_CMD_EXIT;
 }
 
-static void wds_to_ipv4(const char *name, const uint32_t addr)
+static void wds_to_ipv4(struct blob_buf *buf, const char *name, const uint32_t addr)
 {
 	struct in_addr ip_addr;
-	char buf[INET_ADDRSTRLEN];
+	char str[INET_ADDRSTRLEN];
 
 	ip_addr.s_addr = htonl(addr);
-	blobmsg_add_string(&status, name, inet_ntop(AF_INET, &ip_addr, buf, sizeof(buf)));
+	blobmsg_add_string(buf, name, inet_ntop(AF_INET, &ip_addr, str, sizeof(str)));
 }
 
-static void wds_to_ipv6(const char *name, const uint16_t *addr)
+static void wds_to_ipv6(struct blob_buf *buf, const char *name, const uint16_t *addr)
 {
-	char buf[INET6_ADDRSTRLEN];
+	char str[INET6_ADDRSTRLEN];
 	uint16_t ip_addr[8];
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(ip_addr); i++)
 		ip_addr[i] = htons(addr[i]);
 
-	blobmsg_add_string(&status, name, inet_ntop(AF_INET6, &ip_addr, buf, sizeof(buf)));
+	blobmsg_add_string(buf, name, inet_ntop(AF_INET6, &ip_addr, str, sizeof(str)));
 }
 
 static void
-cmd_wds_get_current_settings_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+wds_add_current_settings(struct blob_buf *buf,
+			 struct qmi_wds_get_current_settings_response *res, const char *name)
 {
 	void *v4, *v6, *d, *t;
-	struct qmi_wds_get_current_settings_response res;
 	const char *pdptypes[] = {
 		[QMI_WDS_PDP_TYPE_IPV4] = "ipv4",
 		[QMI_WDS_PDP_TYPE_PPP] = "ppp",
@@ -285,69 +444,234 @@ cmd_wds_get_current_settings_cb(struct qmi_dev *qmi, struct qmi_request *req, st
 	};
 	int i;
 
-	qmi_parse_wds_get_current_settings_response(msg, &res);
+	t = blobmsg_open_table(buf, name);
 
-	t = blobmsg_open_table(&status, NULL);
+	if (res->set.pdp_type && (int) res->data.pdp_type < ARRAY_SIZE(pdptypes))
+		blobmsg_add_string(buf, "pdp-type", pdptypes[res->data.pdp_type]);
 
-	if (res.set.pdp_type && (int) res.data.pdp_type < ARRAY_SIZE(pdptypes))
-		blobmsg_add_string(&status, "pdp-type", pdptypes[res.data.pdp_type]);
-
-	if (res.set.ip_family) {
+	if (res->set.ip_family) {
 		for (i = 0; i < ARRAY_SIZE(modes); i++) {
-			if (modes[i].mode != res.data.ip_family)
+			if (modes[i].mode != res->data.ip_family)
 				continue;
-			blobmsg_add_string(&status, "ip-family", modes[i].name);
+			blobmsg_add_string(buf, "ip-family", modes[i].name);
 			break;
 		}
 	}
 
-	if (res.set.mtu)
-		blobmsg_add_u32(&status, "mtu", res.data.mtu);
+	if (res->set.mtu)
+		blobmsg_add_u32(buf, "mtu", res->data.mtu);
 
 	/* IPV4 */
-	v4 = blobmsg_open_table(&status, "ipv4");
-
-	if (res.set.ipv4_address)
-		wds_to_ipv4("ip", res.data.ipv4_address);
-	if (res.set.primary_ipv4_dns_address)
-		wds_to_ipv4("dns1", res.data.primary_ipv4_dns_address);
-	if (res.set.secondary_ipv4_dns_address)
-		wds_to_ipv4("dns2", res.data.secondary_ipv4_dns_address);
-	if (res.set.ipv4_gateway_address)
-		wds_to_ipv4("gateway", res.data.ipv4_gateway_address);
-	if (res.set.ipv4_gateway_subnet_mask)
-		wds_to_ipv4("subnet", res.data.ipv4_gateway_subnet_mask);
-	blobmsg_close_table(&status, v4);
+	v4 = blobmsg_open_table(buf, "ipv4");
+
+	if (res->set.ipv4_address)
+		wds_to_ipv4(buf, "ip", res->data.ipv4_address);
+	if (res->set.primary_ipv4_dns_address)
+		wds_to_ipv4(buf, "dns1", res->data.primary_ipv4_dns_address);
+	if (res->set.secondary_ipv4_dns_address)
+		wds_to_ipv4(buf, "dns2", res->data.secondary_ipv4_dns_address);
+	if (res->set.ipv4_gateway_address)
+		wds_to_ipv4(buf, "gateway", res->data.ipv4_gateway_address);
+	if (res->set.ipv4_gateway_subnet_mask)
+		wds_to_ipv4(buf, "subnet", res->data.ipv4_gateway_subnet_mask);
+	blobmsg_close_table(buf, v4);
 
 	/* IPV6 */
-	v6 = blobmsg_open_table(&status, "ipv6");
+	v6 = blobmsg_open_table(buf, "ipv6");
 
-	if (res.set.ipv6_address) {
-		wds_to_ipv6("ip", res.data.ipv6_address.address);
-		blobmsg_add_u32(&status, "ip-prefix-length", res.data.ipv6_address.prefix_length);
+	if (res->set.ipv6_address) {
+		wds_to_ipv6(buf, "ip", res->data.ipv6_address.address);
+		blobmsg_add_u32(buf, "ip-prefix-length", res->data.ipv6_address.prefix_length);
 	}
-	if (res.set.ipv6_gateway_address) {
-		wds_to_ipv6("gateway", res.data.ipv6_gateway_address.address);
-		blobmsg_add_u32(&status, "gw-prefix-length", res.data.ipv6_gateway_address.prefix_length);
+	if (res->set.ipv6_gateway_address) {
+		wds_to_ipv6(buf, "gateway", res->data.ipv6_gateway_address.address);
+		blobmsg_add_u32(buf, "gw-prefix-length", res->data.ipv6_gateway_address.prefix_length);
 	}
-	if (res.set.ipv6_primary_dns_address)
-		wds_to_ipv6("dns1", res.data.ipv6_primary_dns_address);
-	if (res.set.ipv6_secondary_dns_address)
-		wds_to_ipv6("dns2", res.data.ipv6_secondary_dns_address);
+	if (res->set.ipv6_primary_dns_address)
+		wds_to_ipv6(buf, "dns1", res->data.ipv6_primary_dns_address);
+	if (res->set.ipv6_secondary_dns_address)
+		wds_to_ipv6(buf, "dns2", res->data.ipv6_secondary_dns_address);
 
-	blobmsg_close_table(&status, v6);
+	blobmsg_close_table(buf, v6);
 
-	d = blobmsg_open_table(&status, "domain-names");
-	for (i = 0; i < res.data.domain_name_list_n; i++) {
-		blobmsg_add_string(&status, NULL, res.data.domain_name_list[i]);
+	d = blobmsg_open_table(buf, "domain-names");
+	for (i = 0; i < res->data.domain_name_list_n; i++) {
+		blobmsg_add_string(buf, NULL, res->data.domain_name_list[i]);
 	}
-	blobmsg_close_table(&status, d);
+	blobmsg_close_table(buf, d);
 
-	blobmsg_close_table(&status, t);
+	blobmsg_close_table(buf, t);
 }
 
+#define WDS_ROUTE_METRIC_DEFAULT	1024
+
+static char *wds_ifname;
+static char *wds_resolv_file;
+static uint32_t wds_route_metric = WDS_ROUTE_METRIC_DEFAULT;
+
+#define cmd_wds_set_ifname_cb no_cb
 static enum qmi_cmd_result
-cmd_wds_get_current_settings_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+cmd_wds_set_ifname_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	wds_ifname = arg;
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wds_set_route_metric_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_set_route_metric_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	char *err;
+	long long metric;
+
+	metric = strtoll(arg, &err, 10);
+	if (!*arg || *err || metric < 0 || metric > UINT32_MAX)
+		return uqmi_add_error("Invalid route metric");
+
+	wds_route_metric = metric;
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wds_set_resolv_file_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_set_resolv_file_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	wds_resolv_file = arg;
+	return QMI_CMD_DONE;
+}
+
+static void wds_ipv6_addr(struct in6_addr *in6, const uint16_t *addr)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		in6->s6_addr[2 * i] = addr[i] >> 8;
+		in6->s6_addr[2 * i + 1] = addr[i] & 0xff;
+	}
+}
+
+static void wds_write_nameserver(FILE *f, int family, const void *addr)
+{
+	char buf[INET6_ADDRSTRLEN];
+
+	fprintf(f, "nameserver %s\n", inet_ntop(family, addr, buf, sizeof(buf)));
+}
+
+static int
+wds_write_resolv_file(struct qmi_wds_get_current_settings_response *res)
+{
+	struct in6_addr in6;
+	struct in_addr in;
+	FILE *f;
+
+	f = fopen(wds_resolv_file, "w");
+	if (!f)
+		return -errno;
+
+	if (res->set.primary_ipv4_dns_address) {
+		in.s_addr = htonl(res->data.primary_ipv4_dns_address);
+		wds_write_nameserver(f, AF_INET, &in);
+	}
+	if (res->set.secondary_ipv4_dns_address) {
+		in.s_addr = htonl(res->data.secondary_ipv4_dns_address);
+		wds_write_nameserver(f, AF_INET, &in);
+	}
+	if (res->set.ipv6_primary_dns_address) {
+		wds_ipv6_addr(&in6, res->data.ipv6_primary_dns_address);
+		wds_write_nameserver(f, AF_INET6, &in6);
+	}
+	if (res->set.ipv6_secondary_dns_address) {
+		wds_ipv6_addr(&in6, res->data.ipv6_secondary_dns_address);
+		wds_write_nameserver(f, AF_INET6, &in6);
+	}
+
+	if (fclose(f))
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * Apply the connection settings to the network interface directly over
+ * rtnetlink, without a round trip through the JSON output and ip(8).
+ */
+static int
+wds_configure_interface(struct qmi_wds_get_current_settings_response *res)
+{
+	struct in6_addr in6, gw6;
+	struct in_addr in, gw;
+	int ifindex;
+	int ret;
+
+	ifindex = if_nametoindex(wds_ifname);
+	if (!ifindex)
+		return -errno;
+
+	ret = netlink_set_link_up(ifindex, res->set.mtu ? res->data.mtu : 0);
+	if (ret)
+		return ret;
+
+	if (res->set.ipv4_address) {
+		in.s_addr = htonl(res->data.ipv4_address);
+		gw.s_addr = htonl(res->data.ipv4_gateway_address);
+
+		ret = netlink_flush_addresses(ifindex, AF_INET);
+		if (!ret)
+			ret = netlink_add_address(ifindex, AF_INET, &in,
+				res->set.ipv4_gateway_subnet_mask ?
+				__builtin_popcount(res->data.ipv4_gateway_subnet_mask) : 32);
+		if (!ret)
+			ret = netlink_add_default_route(ifindex, AF_INET,
+				res->set.ipv4_gateway_address ? &gw : NULL,
+				wds_route_metric);
+		if (ret)
+			return ret;
+	}
+
+	if (res->set.ipv6_address) {
+		wds_ipv6_addr(&in6, res->data.ipv6_address.address);
+		wds_ipv6_addr(&gw6, res->data.ipv6_gateway_address.address);
+
+		ret = netlink_flush_addresses(ifindex, AF_INET6);
+		if (!ret)
+			ret = netlink_add_address(ifindex, AF_INET6, &in6,
+						  res->data.ipv6_address.prefix_length);
+		if (!ret)
+			ret = netlink_add_default_route(ifindex, AF_INET6,
+				res->set.ipv6_gateway_address ? &gw6 : NULL,
+				wds_route_metric);
+		if (ret)
+			return ret;
+	}
+
+	if (wds_resolv_file)
+		return wds_write_resolv_file(res);
+
+	return 0;
+}
+
+static void
+cmd_wds_get_current_settings_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wds_get_current_settings_response res;
+	char buf[128];
+	int ret;
+
+	qmi_parse_wds_get_current_settings_response(msg, &res);
+	wds_add_current_settings(&status, &res, NULL);
+
+	if (!wds_ifname)
+		return;
+
+	ret = wds_configure_interface(&res);
+	if (!ret)
+		return;
+
+	snprintf(buf, sizeof(buf), "Failed to configure %s: %s", wds_ifname, strerror(-ret));
+	uqmi_add_error(buf);
+}
+
+static void wds_set_current_settings_request(struct qmi_msg *msg)
 {
 	struct qmi_wds_get_current_settings_request gcs_req;
 	memset(&gcs_req, '\0', sizeof(struct qmi_wds_get_current_settings_request));
@@ -361,5 +685,807 @@ cmd_wds_get_current_settings_prepare(struct qmi_dev *qmi, struct qmi_request *re
 		QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_DOMAIN_NAME_LIST |
 		QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_IP_FAMILY);
 	qmi_set_wds_get_current_settings_request(msg, &gcs_req);
+}
+
+static enum qmi_cmd_result
+cmd_wds_get_current_settings_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	wds_set_current_settings_request(msg);
+	return QMI_CMD_REQUEST;
+}
+
+#define WDS_MAX_SESSIONS	8
+
+/*
+ * A data session on its own WDS client. Sessions are started, stopped and
+ * queried in parallel: every request of a phase is sent before waiting for
+ * the first response.
+ */
+struct wds_session {
+	struct qmi_request req;
+	struct qmi_client cl;
+	const char *name;
+	char *apn;
+	int profile;
+	int family;
+	int cid;
+	uint32_t pdh;
+	bool has_pdh;
+	int conn_status;
+	struct blob_attr *settings;
+	int ret;
+};
+
+static struct wds_session wds_sessions[WDS_MAX_SESSIONS];
+static int wds_n_sessions;
+
+static void wds_session_init(struct wds_session *s, const char *name)
+{
+	memset(s, 0, sizeof(*s));
+	s->name = name;
+	s->profile = -1;
+	s->family = -1;
+	s->cid = -1;
+}
+
+static void
+wds_session_start_network_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct wds_session *s = container_of(req, struct wds_session, req);
+	struct qmi_wds_start_network_response res;
+
+	qmi_parse_wds_start_network_response(msg, &res);
+	if (res.set.packet_data_handle) {
+		s->pdh = res.data.packet_data_handle;
+		s->has_pdh = true;
+	}
+}
+
+/* responses arrive in any order, keep the settings until the output is built */
+static void
+wds_session_current_settings_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct wds_session *s = container_of(req, struct wds_session, req);
+	struct qmi_wds_get_current_settings_response res;
+	struct blob_buf buf = {};
+
+	blob_buf_init(&buf, 0);
+	qmi_parse_wds_get_current_settings_response(msg, &res);
+	wds_add_current_settings(&buf, &res, "settings");
+	s->settings = blob_memdup(blob_data(buf.head));
+	blob_buf_free(&buf);
+}
+
+static void
+wds_session_status_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct wds_session *s = container_of(req, struct wds_session, req);
+	struct qmi_wds_get_packet_service_status_response res;
+
+	qmi_parse_wds_get_packet_service_status_response(msg, &res);
+	if (res.set.connection_status)
+		s->conn_status = res.data.connection_status;
+}
+
+static void wds_sessions_wait(struct qmi_dev *qmi, struct wds_session *s, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (s[i].ret)
+			continue;
+
+		s[i].ret = qmi_request_wait(qmi, &s[i].req);
+	}
+}
+
+static int
+wds_sessions_open(struct qmi_dev *qmi, struct wds_session *s, int n, bool keep)
+{
+	int n_open = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		s[i].ret = qmi_client_open(qmi, &s[i].cl, QMI_SERVICE_WDS, s[i].cid);
+		if (s[i].ret)
+			continue;
+
+		s[i].cl.keep = keep;
+		n_open++;
+	}
+
+	return n_open;
+}
+
+static enum qmi_cmd_result
+wds_sessions_start(struct qmi_dev *qmi, struct qmi_msg *msg, struct wds_session *s, int n,
+		   bool keep)
+{
+	struct qmi_wds_set_ip_family_request ipf_req = {};
+	struct qmi_wds_start_network_request sn_req;
+	struct qmi_request *req;
+	int n_failed = 0;
+	void *c, *t;
+	int i;
+
+	if (!wds_sessions_open(qmi, s, n, keep))
+		return uqmi_add_error("Failed to connect to service");
+
+	/* older firmware does not know Set IP Family, ignore its result */
+	for (i = 0; i < n; i++) {
+		if (s[i].ret || s[i].family < 0)
+			continue;
+
+		qmi_set(&ipf_req, preference, s[i].family);
+		qmi_set_wds_set_ip_family_request(msg, &ipf_req);
+		qmi_client_request_start(qmi, &s[i].cl, &s[i].req, NULL);
+	}
+	for (i = 0; i < n; i++) {
+		if (!s[i].ret && s[i].family >= 0)
+			qmi_request_wait(qmi, &s[i].req);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (s[i].ret)
+			continue;
+
+		sn_req = wds_sn_req;
+		if (s[i].apn)
+			qmi_set_ptr(&sn_req, apn, s[i].apn);
+		if (s[i].profile >= 0)
+			qmi_set(&sn_req, profile_index_3gpp, s[i].profile);
+		if (s[i].family >= 0)
+			qmi_set(&sn_req, ip_family_preference, s[i].family);
+
+		req = &s[i].req;
+		qmi_set_wds_start_network_request(msg, &sn_req);
+		qmi_client_request_start(qmi, &s[i].cl, req, wds_session_start_network_cb);
+		req->no_error_cb = true;
+	}
+	wds_sessions_wait(qmi, s, n);
+
+	for (i = 0; i < n; i++) {
+		if (s[i].ret)
+			continue;
+
+		req = &s[i].req;
+		wds_set_current_settings_request(msg);
+		qmi_client_request_start(qmi, &s[i].cl, req, wds_session_current_settings_cb);
+		req->no_error_cb = true;
+	}
+	for (i = 0; i < n; i++) {
+		if (!s[i].ret)
+			qmi_request_wait(qmi, &s[i].req);
+	}
+
+	c = blobmsg_open_table(&status, NULL);
+	for (i = 0; i < n; i++) {
+		t = blobmsg_open_table(&status, s[i].name);
+		if (s[i].ret) {
+			blobmsg_add_string(&status, "error", qmi_get_error_str(s[i].ret));
+			s[i].cl.keep = false;
+			n_failed++;
+		} else {
+			blobmsg_add_u32(&status, "cid", s[i].cl.client_id);
+			if (s[i].has_pdh)
+				blobmsg_add_u32(&status, "pdh", s[i].pdh);
+			if (s[i].settings)
+				blobmsg_add_field(&status, BLOBMSG_TYPE_TABLE, "settings",
+						  blobmsg_data(s[i].settings),
+						  blobmsg_data_len(s[i].settings));
+		}
+		blobmsg_close_table(&status, t);
+
+		free(s[i].settings);
+		s[i].settings = NULL;
+	}
+	blobmsg_close_table(&status, c);
+
+	if (n_failed == n)
+		return QMI_CMD_EXIT;
+
+	return QMI_CMD_DONE;
+}
+
+/*
+ * Bring up IPv4 and IPv6 on two separate WDS clients, so the total connect
+ * time is that of the slower family rather than the sum of both.
+ */
+static enum qmi_cmd_result
+wds_start_network_dual_stack(struct qmi_dev *qmi, struct qmi_msg *msg)
+{
+	static struct wds_session s[2];
+
+	wds_session_init(&s[0], "ipv4");
+	s[0].family = QMI_WDS_IP_FAMILY_IPV4;
+	wds_session_init(&s[1], "ipv6");
+	s[1].family = QMI_WDS_IP_FAMILY_IPV6;
+
+	return wds_sessions_start(qmi, msg, s, ARRAY_SIZE(s),
+				  qmi_service_keep_client_id(qmi, QMI_SERVICE_WDS));
+}
+
+#define cmd_wds_add_session_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_add_session_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	static const struct {
+		const char *name;
+		const QmiWdsIpFamily mode;
+	} modes[] = {
+		{ "ipv4", QMI_WDS_IP_FAMILY_IPV4 },
+		{ "ipv6", QMI_WDS_IP_FAMILY_IPV6 },
+		{ "unspecified", QMI_WDS_IP_FAMILY_UNSPECIFIED },
+	};
+	struct wds_session *s;
+	char *key, *val, *err;
+	int i;
+
+	if (wds_n_sessions >= ARRAY_SIZE(wds_sessions))
+		return uqmi_add_error("Too many sessions");
+
+	s = &wds_sessions[wds_n_sessions];
+	wds_session_init(s, NULL);
+
+	for (key = strtok(arg, ","); key; key = strtok(NULL, ",")) {
+		val = strchr(key, '=');
+		if (!val)
+			goto error;
+
+		*(val++) = 0;
+		if (!strcmp(key, "name")) {
+			s->name = val;
+		} else if (!strcmp(key, "apn")) {
+			s->apn = val;
+		} else if (!strcmp(key, "profile")) {
+			s->profile = strtoul(val, &err, 10);
+			if (!*val || *err || s->profile > 0xff)
+				goto error;
+		} else if (!strcmp(key, "cid")) {
+			s->cid = strtoul(val, &err, 10);
+			if (!*val || *err || s->cid > 0xff)
+				goto error;
+		} else if (!strcmp(key, "pdh")) {
+			s->pdh = strtoul(val, &err, 0);
+			if (!*val || *err)
+				goto error;
+			s->has_pdh = true;
+		} else if (!strcmp(key, "ip-family")) {
+			for (i = 0; i < ARRAY_SIZE(modes); i++) {
+				if (!strcasecmp(modes[i].name, val))
+					break;
+			}
+			if (i == ARRAY_SIZE(modes))
+				goto error;
+			s->family = modes[i].mode;
+		} else {
+			goto error;
+		}
+	}
+
+	if (!s->name)
+		s->name = s->apn;
+	if (!s->name)
+		return uqmi_add_error("Session needs a name or an apn");
+
+	wds_n_sessions++;
+	return QMI_CMD_DONE;
+
+error:
+	return uqmi_add_error("Invalid session (keys: name, apn, profile, ip-family, cid, pdh)");
+}
+
+#define cmd_wds_start_sessions_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_start_sessions_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	if (!wds_n_sessions)
+		return uqmi_add_error("No sessions given");
+
+	/* the client ids are needed to stop the sessions later on */
+	return wds_sessions_start(qmi, msg, wds_sessions, wds_n_sessions, true);
+}
+
+#define cmd_wds_stop_sessions_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_stop_sessions_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	struct qmi_wds_stop_network_request stn_req;
+	struct wds_session *s = wds_sessions;
+	int n = wds_n_sessions;
+	int n_failed = 0;
+	void *c;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (s[i].cid < 0 || !s[i].has_pdh)
+			return uqmi_add_error("Stopping a session requires its cid and pdh");
+	}
+
+	if (!n)
+		return uqmi_add_error("No sessions given");
+
+	wds_sessions_open(qmi, s, n, false);
+
+	for (i = 0; i < n; i++) {
+		if (s[i].ret)
+			continue;
+
+		stn_req = wds_stn_req;
+		qmi_set(&stn_req, packet_data_handle, s[i].pdh);
+		qmi_set_wds_stop_network_request(msg, &stn_req);
+		qmi_client_request_start(qmi, &s[i].cl, &s[i].req, NULL);
+	}
+	wds_sessions_wait(qmi, s, n);
+
+	c = blobmsg_open_table(&status, NULL);
+	for (i = 0; i < n; i++) {
+		if (s[i].ret) {
+			/* keep the client id so that stopping can be retried */
+			s[i].cl.keep = true;
+			n_failed++;
+		}
+
+		blobmsg_add_string(&status, s[i].name,
+				   s[i].ret ? qmi_get_error_str(s[i].ret) : "stopped");
+	}
+	blobmsg_close_table(&status, c);
+
+	if (n_failed == n)
+		return QMI_CMD_EXIT;
+
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wds_get_sessions_status_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_get_sessions_status_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	struct wds_session *s = wds_sessions;
+	int n = wds_n_sessions;
+	void *c, *t;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (s[i].cid < 0)
+			return uqmi_add_error("Querying a session requires its cid");
+	}
+
+	if (!n)
+		return uqmi_add_error("No sessions given");
+
+	wds_sessions_open(qmi, s, n, true);
+
+	for (i = 0; i < n; i++) {
+		if (s[i].ret)
+			continue;
+
+		qmi_set_wds_get_packet_service_status_request(msg);
+		qmi_client_request_start(qmi, &s[i].cl, &s[i].req, wds_session_status_cb);
+		s[i].req.no_error_cb = true;
+	}
+	wds_sessions_wait(qmi, s, n);
+
+	c = blobmsg_open_table(&status, NULL);
+	for (i = 0; i < n; i++) {
+		t = blobmsg_open_table(&status, s[i].name);
+		blobmsg_add_u32(&status, "cid", s[i].cid);
+		if (s[i].has_pdh)
+			blobmsg_add_u32(&status, "pdh", s[i].pdh);
+		if (s[i].ret)
+			blobmsg_add_string(&status, "error", qmi_get_error_str(s[i].ret));
+		else
+			blobmsg_add_string(&status, "status", wds_get_connection_status(s[i].conn_status));
+		blobmsg_close_table(&status, t);
+	}
+	blobmsg_close_table(&status, c);
+
+	return QMI_CMD_DONE;
+}
+
+#define WDS_PACKET_STATISTICS_MASK \
+	(QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_PACKETS_OK | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_PACKETS_OK | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_PACKETS_ERROR | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_PACKETS_ERROR | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_OVERFLOWS | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_OVERFLOWS | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_BYTES_OK | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_BYTES_OK | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_TX_PACKETS_DROPPED | \
+	 QMI_WDS_PACKET_STATISTICS_MASK_FLAG_RX_PACKETS_DROPPED)
+
+static struct {
+	bool valid;
+	struct timespec time;
+	struct qmi_wds_get_packet_statistics_response res;
+} wds_stats_prev;
+
+static void
+wds_add_packet_statistics(struct blob_buf *buf, struct qmi_wds_get_packet_statistics_response *res)
+{
+#define add_u32(_field) \
+	if (res->set._field) \
+		blobmsg_add_u32(buf, #_field, res->data._field)
+#define add_u64(_field) \
+	if (res->set._field) \
+		blobmsg_add_u64(buf, #_field, res->data._field)
+
+	add_u32(tx_packets_ok);
+	add_u32(rx_packets_ok);
+	add_u32(tx_packets_error);
+	add_u32(rx_packets_error);
+	add_u32(tx_overflows);
+	add_u32(rx_overflows);
+	add_u32(tx_packets_dropped);
+	add_u32(rx_packets_dropped);
+	add_u64(tx_bytes_ok);
+	add_u64(rx_bytes_ok);
+	add_u64(last_call_tx_bytes_ok);
+	add_u64(last_call_rx_bytes_ok);
+
+#undef add_u32
+#undef add_u64
+}
+
+static void
+wds_add_drop_ratio(struct blob_buf *buf, const char *name, uint32_t ok, uint32_t dropped)
+{
+	uint32_t total = ok + dropped;
+
+	blobmsg_add_double(buf, name, total ? (double) dropped / total : 0);
+}
+
+static void
+wds_add_packet_rates(struct blob_buf *buf, struct qmi_wds_get_packet_statistics_response *res,
+		     struct qmi_wds_get_packet_statistics_response *prev,
+		     uint64_t msecs)
+{
+	void *c;
+
+	if (!msecs)
+		return;
+
+	c = blobmsg_open_table(buf, "rates");
+	blobmsg_add_u32(buf, "interval_ms", msecs);
+
+	/* counters are free running, unsigned subtraction handles wraparound */
+#define add_rate(_name, _type, _field) \
+	if (res->set._field && prev->set._field) \
+		blobmsg_add_u64(buf, _name, \
+				(uint64_t) (_type) (res->data._field - prev->data._field) * 1000 / msecs)
+
+	add_rate("tx_bytes_per_sec", uint64_t, tx_bytes_ok);
+	add_rate("rx_bytes_per_sec", uint64_t, rx_bytes_ok);
+	add_rate("tx_packets_per_sec", uint32_t, tx_packets_ok);
+	add_rate("rx_packets_per_sec", uint32_t, rx_packets_ok);
+#undef add_rate
+
+	if (res->set.tx_packets_ok && res->set.tx_packets_dropped &&
+	    prev->set.tx_packets_ok && prev->set.tx_packets_dropped)
+		wds_add_drop_ratio(buf, "tx_drop_ratio",
+				   res->data.tx_packets_ok - prev->data.tx_packets_ok,
+				   res->data.tx_packets_dropped - prev->data.tx_packets_dropped);
+
+	if (res->set.rx_packets_ok && res->set.rx_packets_dropped &&
+	    prev->set.rx_packets_ok && prev->set.rx_packets_dropped)
+		wds_add_drop_ratio(buf, "rx_drop_ratio",
+				   res->data.rx_packets_ok - prev->data.rx_packets_ok,
+				   res->data.rx_packets_dropped - prev->data.rx_packets_dropped);
+
+	blobmsg_close_table(buf, c);
+}
+
+static void
+wds_decode_packet_statistics(struct blob_buf *buf, struct qmi_msg *msg)
+{
+	struct qmi_wds_get_packet_statistics_response res;
+	void *c;
+
+	qmi_parse_wds_get_packet_statistics_response(msg, &res);
+
+	c = blobmsg_open_table(buf, NULL);
+	wds_add_packet_statistics(buf, &res);
+	blobmsg_close_table(buf, c);
+}
+
+static void
+cmd_wds_get_packet_statistics_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	wds_decode_packet_statistics(&status, msg);
+}
+
+static enum qmi_cmd_result
+cmd_wds_get_packet_statistics_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	struct qmi_wds_get_packet_statistics_request sreq = {
+		QMI_INIT(mask, WDS_PACKET_STATISTICS_MASK),
+	};
+
+	qmi_set_wds_get_packet_statistics_request(msg, &sreq);
 	return QMI_CMD_REQUEST;
 }
+
+static void
+cmd_wds_monitor_packet_statistics_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wds_get_packet_statistics_response res;
+	struct timespec now;
+	uint64_t msecs = 0;
+	void *c;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	qmi_parse_wds_get_packet_statistics_response(msg, &res);
+
+	c = blobmsg_open_table(&status, NULL);
+	wds_add_packet_statistics(&status, &res);
+	if (wds_stats_prev.valid) {
+		msecs = (now.tv_sec - wds_stats_prev.time.tv_sec) * 1000 +
+			(now.tv_nsec - wds_stats_prev.time.tv_nsec) / 1000000;
+		wds_add_packet_rates(&status, &res, &wds_stats_prev.res, msecs);
+	}
+	blobmsg_close_table(&status, c);
+
+	wds_stats_prev.valid = true;
+	wds_stats_prev.time = now;
+	wds_stats_prev.res = res;
+}
+
+static enum qmi_cmd_result
+cmd_wds_monitor_packet_statistics_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	struct qmi_wds_get_packet_statistics_request sreq = {
+		QMI_INIT(mask, WDS_PACKET_STATISTICS_MASK),
+	};
+	bool complete = false;
+	long interval;
+	char *err;
+
+	interval = strtol(arg, &err, 10);
+	if ((err && *err) || interval <= 0 || interval > INT_MAX / 1000) {
+		uqmi_add_error("Invalid interval");
+		return QMI_CMD_EXIT;
+	}
+
+	while (!cancel_all_requests) {
+		qmi_set_wds_get_packet_statistics_request(msg, &sreq);
+		qmi_request_start(qmi, req, cmd_wds_monitor_packet_statistics_cb);
+		req->no_error_cb = true;
+		if (qmi_request_wait(qmi, req)) {
+			if (cancel_all_requests)
+				break;
+
+			uqmi_add_error(qmi_get_error_str(req->ret));
+			return QMI_CMD_EXIT;
+		}
+
+		uqmi_flush_result();
+
+		qmi_device_wait(qmi, &complete, interval * 1000);
+	}
+
+	return QMI_CMD_DONE;
+}
+
+#define WDS_SUPERVISE_BACKOFF_MIN	1000
+#define WDS_SUPERVISE_BACKOFF_MAX	64000
+/* a session that stayed up this long resets the backoff */
+#define WDS_SUPERVISE_STABLE		60000
+
+static int wda_apply_data_format(struct qmi_dev *qmi, struct qmi_msg *msg);
+
+static struct {
+	struct qmi_indication ind;
+	uint32_t pdh;
+	bool has_pdh;
+	bool started;
+	bool event;
+	bool disconnected;
+	bool reconfigure;
+} wds_sv;
+
+static void
+wds_supervise_ind_cb(struct qmi_dev *qmi, struct qmi_indication *ind, struct qmi_msg *msg)
+{
+	struct qmi_wds_packet_service_status_indication res;
+	void *c;
+
+	/*
+	 * Indications do not name the session they refer to. Until the Start
+	 * Network response of the current attempt is in, they may still be
+	 * about the previous one, e.g. the teardown of a dropped session.
+	 */
+	if (!wds_sv.started)
+		return;
+
+	qmi_parse_wds_packet_service_status_indication(msg, &res);
+	if (!res.set.connection_status)
+		return;
+
+	switch (res.data.connection_status.status) {
+	case QMI_WDS_CONNECTION_STATUS_DISCONNECTED:
+		c = blobmsg_open_table(&status, NULL);
+		blobmsg_add_string(&status, "event", "disconnected");
+		wds_add_packet_service_status(&res);
+		blobmsg_close_table(&status, c);
+		uqmi_flush_result();
+
+		wds_sv.has_pdh = false;
+		wds_sv.started = false;
+		wds_sv.disconnected = true;
+		break;
+	case QMI_WDS_CONNECTION_STATUS_CONNECTED:
+		if (!res.data.connection_status.reconfiguration_required)
+			return;
+
+		wds_sv.reconfigure = true;
+		break;
+	default:
+		return;
+	}
+
+	wds_sv.event = true;
+	uloop_end();
+}
+
+static void
+wds_supervise_start_network_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wds_start_network_response res;
+
+	wds_sv.started = true;
+	qmi_parse_wds_start_network_response(msg, &res);
+	if (!res.set.packet_data_handle)
+		return;
+
+	wds_sv.pdh = res.data.packet_data_handle;
+	wds_sv.has_pdh = true;
+}
+
+static void
+wds_supervise_settings_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wds_get_current_settings_response res;
+	int ret;
+
+	qmi_parse_wds_get_current_settings_response(msg, &res);
+	wds_add_current_settings(&status, &res, "settings");
+
+	if (!wds_ifname)
+		return;
+
+	ret = wds_configure_interface(&res);
+	if (ret)
+		blobmsg_add_string(&status, "error", strerror(-ret));
+}
+
+static void
+wds_supervise_report(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg,
+		     const char *event)
+{
+	void *c;
+
+	c = blobmsg_open_table(&status, NULL);
+	blobmsg_add_string(&status, "event", event);
+	if (wds_sv.has_pdh)
+		blobmsg_add_u32(&status, "pdh", wds_sv.pdh);
+
+	wds_set_current_settings_request(msg);
+	qmi_request_start(qmi, req, wds_supervise_settings_cb);
+	req->no_error_cb = true;
+	qmi_request_wait(qmi, req);
+
+	blobmsg_close_table(&status, c);
+	uqmi_flush_result();
+}
+
+static int
+wds_supervise_connect(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	int ret;
+
+	/* a modem reset loses the data format, apply it again if one was set */
+	ret = wda_apply_data_format(qmi, msg);
+	if (ret)
+		return ret;
+
+	qmi_set_wds_start_network_request(msg, &wds_sn_req);
+	qmi_request_start(qmi, req, wds_supervise_start_network_cb);
+	req->no_error_cb = true;
+	ret = qmi_request_wait(qmi, req);
+
+	/* the session is already up, e.g. through autoconnect */
+	if (ret == QMI_PROTOCOL_ERROR_NO_EFFECT)
+		ret = 0;
+
+	return ret;
+}
+
+#define cmd_wds_supervise_network_cb no_cb
+static enum qmi_cmd_result
+cmd_wds_supervise_network_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	int backoff = WDS_SUPERVISE_BACKOFF_MIN;
+	struct timespec start, now;
+	bool never = false;
+	long uptime;
+	int delay;
+	int ret;
+	void *c;
+
+	srandom(time(NULL) ^ getpid());
+
+	qmi_indication_register(qmi, &wds_sv.ind, QMI_SERVICE_WDS,
+				QMI_WDS_PACKET_SERVICE_STATUS_INDICATION,
+				wds_supervise_ind_cb);
+
+	while (!cancel_all_requests) {
+		wds_sv.started = false;
+		wds_sv.event = false;
+		wds_sv.disconnected = false;
+		wds_sv.reconfigure = false;
+
+		ret = wds_supervise_connect(qmi, req, msg);
+		if (!ret) {
+			/* also when the session was already up */
+			wds_sv.started = true;
+			wds_supervise_report(qmi, req, msg, "connected");
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+			while (!wds_sv.disconnected) {
+				if (qmi_device_wait(qmi, &wds_sv.event, -1))
+					break;
+
+				wds_sv.event = false;
+				if (wds_sv.reconfigure) {
+					wds_sv.reconfigure = false;
+					wds_supervise_report(qmi, req, msg, "reconfigured");
+				}
+			}
+
+			if (cancel_all_requests)
+				break;
+
+			/*
+			 * reconnect right away after a drop of a stable session,
+			 * back off if the bearer keeps dropping shortly after
+			 * coming up
+			 */
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			uptime = (now.tv_sec - start.tv_sec) * 1000 +
+				 (now.tv_nsec - start.tv_nsec) / 1000000;
+			if (uptime >= WDS_SUPERVISE_STABLE) {
+				backoff = WDS_SUPERVISE_BACKOFF_MIN;
+				continue;
+			}
+		}
+
+		if (cancel_all_requests)
+			break;
+
+		/* jitter between half and the full backoff */
+		delay = backoff / 2 + random() % (backoff / 2 + 1);
+
+		c = blobmsg_open_table(&status, NULL);
+		if (ret) {
+			blobmsg_add_string(&status, "event", "connect-failed");
+			blobmsg_add_string(&status, "error", qmi_get_error_str(ret));
+		} else {
+			blobmsg_add_string(&status, "event", "unstable");
+		}
+		blobmsg_add_u32(&status, "retry-in-ms", delay);
+		blobmsg_close_table(&status, c);
+		uqmi_flush_result();
+
+		if (qmi_device_wait(qmi, &never, delay) != QMI_ERROR_TIMEOUT)
+			break;
+
+		backoff *= 2;
+		if (backoff > WDS_SUPERVISE_BACKOFF_MAX)
+			backoff = WDS_SUPERVISE_BACKOFF_MAX;
+	}
+
+	qmi_indication_unregister(qmi, &wds_sv.ind);
+
+	return QMI_CMD_DONE;
+}
@@ -29,11 +29,23 @@
 	__uqmi_command(wds_set_autoconnect, autoconnect, no, CMD_TYPE_OPTION), \
 	__uqmi_command(wds_set_profile, profile, required, CMD_TYPE_OPTION), \
 	__uqmi_command(wds_stop_network, stop-network, required, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_add_session, session, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wds_start_sessions, start-sessions, no, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_stop_sessions, stop-sessions, no, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_get_sessions_status, get-sessions-status, no, QMI_SERVICE_WDS), \
 	__uqmi_command(wds_get_packet_service_status, get-data-status, no, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_wait_data_status, wait-data-status, required, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_watch_data_status, watch-data-status, no, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_supervise_network, supervise-network, no, QMI_SERVICE_WDS), \
 	__uqmi_command(wds_set_ip_family, set-ip-family, required, QMI_SERVICE_WDS), \
 	__uqmi_command(wds_set_autoconnect_setting, set-autoconnect, required, QMI_SERVICE_WDS), \
 	__uqmi_command(wds_reset, reset-wds, no, QMI_SERVICE_WDS), \
-	__uqmi_command(wds_get_current_settings, get-current-settings, no, QMI_SERVICE_WDS) \
+	__uqmi_command(wds_get_current_settings, get-current-settings, no, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_set_ifname, configure-interface, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wds_set_resolv_file, resolv-file, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wds_set_route_metric, route-metric, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wds_get_packet_statistics, get-packet-statistics, no, QMI_SERVICE_WDS), \
+	__uqmi_command(wds_monitor_packet_statistics, monitor-packet-statistics, required, QMI_SERVICE_WDS) \
 
 
 #define wds_helptext \
@@ -42,13 +54,29 @@
 		"    --auth-type pap|chap|both|none: Use network authentication type\n" \
 		"    --username <name>:              Use network username\n" \
 		"    --password <password>:          Use network password\n" \
-		"    --ip-family <family>:           Use ip-family for the connection (ipv4, ipv6, unspecified)\n" \
+		"    --ip-family <family>:           Use ip-family for the connection (ipv4, ipv6, ipv4v6, unspecified)\n" \
+		"                                    ipv4v6 starts both families on two new client IDs at once\n" \
 		"    --autoconnect:                  Enable automatic connect/reconnect\n" \
 		"    --profile <index>:              Use connection profile\n" \
 		"  --stop-network <pdh>:             Stop network connection (use with option below)\n" \
 		"    --autoconnect:                  Disable automatic connect/reconnect\n" \
+		"  --start-sessions:                 Start all sessions in parallel, each on its own client ID\n" \
+		"                                    (uses the connection options of --start-network)\n" \
+		"  --stop-sessions:                  Stop all sessions in parallel (requires cid and pdh)\n" \
+		"  --get-sessions-status:            Get the data status of all sessions (requires cid)\n" \
+		"    --session <key>=<val>[,...]:    Add a session (keys: name, apn, profile, ip-family, cid, pdh)\n" \
 		"  --get-data-status:                Get current data access status\n" \
+		"  --wait-data-status <timeout>:     Wait up to <timeout> seconds for a connect or disconnect event\n" \
+		"  --watch-data-status:              Print every data access status change with its end reason\n" \
+		"  --supervise-network:              Start the network and keep it up, reconnecting with backoff\n" \
+		"                                    (uses the options of --start-network, --configure-interface\n" \
+		"                                    and a previous --wda-set-data-format)\n" \
 		"  --set-ip-family <val>:            Set ip-family (ipv4, ipv6, unspecified)\n" \
 		"  --set-autoconnect <val>:          Set automatic connect/reconnect (disabled, enabled, paused)\n" \
 		"  --get-current-settings:           Get current connection settings\n" \
+		"    --configure-interface <ifname>: Apply addresses, default routes and MTU to <ifname>\n" \
+		"    --resolv-file <file>:           Write the DNS servers to <file> (with --configure-interface)\n" \
+		"    --route-metric <metric>:        Metric of the default routes (default: 1024)\n" \
+		"  --get-packet-statistics:          Get modem packet and byte counters\n" \
+		"  --monitor-packet-statistics <s>:  Print counters, rates and drop ratios every <s> seconds\n" \
 
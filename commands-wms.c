@@ -24,6 +24,53 @@
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define CEILDIV(x,y) (((x) + (y) - 1) / (y))
 
+#define WMS_TAG_DEFAULT		-1
+#define WMS_TAG_ALL		-2
+
+static QmiWmsStorageType wms_storage = QMI_WMS_STORAGE_TYPE_UIM;
+static int wms_tag = WMS_TAG_DEFAULT;
+
+#define cmd_wms_storage_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_storage_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	if (!strcmp(arg, "uim"))
+		wms_storage = QMI_WMS_STORAGE_TYPE_UIM;
+	else if (!strcmp(arg, "nv"))
+		wms_storage = QMI_WMS_STORAGE_TYPE_NV;
+	else
+		return uqmi_add_error("Invalid SMS storage");
+
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wms_tag_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_tag_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	static const struct {
+		const char *name;
+		int val;
+	} tags[] = {
+		{ "read", QMI_WMS_MESSAGE_TAG_TYPE_MT_READ },
+		{ "unread", QMI_WMS_MESSAGE_TAG_TYPE_MT_NOT_READ },
+		{ "sent", QMI_WMS_MESSAGE_TAG_TYPE_MO_SENT },
+		{ "unsent", QMI_WMS_MESSAGE_TAG_TYPE_MO_NOT_SENT },
+		{ "all", WMS_TAG_ALL },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tags); i++) {
+		if (strcmp(tags[i].name, arg) != 0)
+			continue;
+
+		wms_tag = tags[i].val;
+		return QMI_CMD_DONE;
+	}
+
+	return uqmi_add_error("Invalid SMS tag");
+}
+
 static void cmd_wms_list_messages_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
 {
 	struct qmi_wms_list_messages_response res;
@@ -46,144 +93,17 @@ cmd_wms_list_messages_prepare(struct qmi_dev *qmi, struct qmi_request *req, stru
 		QMI_INIT(message_tag, QMI_WMS_MESSAGE_TAG_TYPE_MT_NOT_READ),
 	};
 
+	mreq.data.storage_type = wms_storage;
+	mreq.set.message_tag = wms_tag != WMS_TAG_ALL;
+	if (wms_tag >= 0)
+		mreq.data.message_tag = wms_tag;
+
 	qmi_set_wms_list_messages_request(msg, &mreq);
 
 	return QMI_CMD_REQUEST;
 }
 
-static int
-put_unicode_char(char *dest, uint16_t c)
-{
-	if (c < 0x80) {
-		*dest = c;
-		return 1;
-	} else if (c < 0x800) {
-		*(dest++) = 0xc0 | ((c >> 6) & 0x1f);
-		*dest = 0x80 | (c & 0x3f);
-		return 2;
-	} else {
-		*(dest++) = 0xe0 | ((c >> 12) & 0xf);
-		*(dest++) = 0x80 | ((c >> 6) & 0x3f);
-		*dest = 0x80 | (c & 0x3f);
-		return 3;
-	}
-}
-
-
-static int
-pdu_decode_7bit_char(char *dest, int len, unsigned char c, bool *escape)
-{
-	uint16_t conv_0x20[] = {
-		0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
-		0x00F2, 0x00E7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
-		0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
-		0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
-	};
-	uint16_t conv_0x5b[] = {
-		0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7, 0x00BF,
-	};
-	uint16_t conv_0x7b[] = {
-		0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0
-	};
-	int cur_len = 0;
-	uint16_t outc;
-
-	fprintf(stderr, " %02x", c);
-	dest += len;
-	if (*escape) {
-		*escape = false;
-		switch(c) {
-		case 0x0A:
-			*dest = 0x0C;
-			return 1;
-		case 0x14:
-			*dest = 0x5E;
-			return 1;
-		case 0x28:
-			*dest = 0x7B;
-			return 1;
-		case 0x29:
-			*dest = 0x7D;
-			return 1;
-		case 0x2F:
-			*dest = 0x5C;
-			return 1;
-		case 0x3C:
-			*dest = 0x5B;
-			return 1;
-		case 0x3D:
-			*dest = 0x7E;
-			return 1;
-		case 0x3E:
-			*dest = 0x5D;
-			return 1;
-		case 0x40:
-			*dest = 0x7C;
-			return 1;
-		case 0x65:
-			outc = 0x20AC;
-			goto out;
-		case 0x1B:
-			goto normal;
-		default:
-			/* invalid */
-			*(dest++) = conv_0x20[0x1B];
-			cur_len++;
-			goto normal;
-		}
-	}
-
-	if (c == 0x1b) {
-		*escape = true;
-		return 0;
-	}
-
-normal:
-	if (c < 0x20)
-		outc = conv_0x20[(int) c];
-	else if (c == 0x40)
-		outc = 0x00A1;
-	else if (c >= 0x5b && c <= 0x60)
-		outc = conv_0x5b[c - 0x5b];
-	else if (c >= 0x7b && c <= 0x7f)
-		outc = conv_0x7b[c - 0x7b];
-	else
-		outc = c;
-
-out:
-	return cur_len + put_unicode_char(dest, outc);
-}
-
-static int
-pdu_decode_7bit_str(char *dest, const unsigned char *data, int data_len, int bit_offset)
-{
-	bool escape = false;
-	int len = 0;
-	int i;
-
-	fprintf(stderr, "Raw text:");
-	for (i = 0; i < data_len; i++) {
-		int pos = (i + bit_offset) % 7;
-
-		if (pos == 0) {
-			len += pdu_decode_7bit_char(dest, len, data[i] & 0x7f, &escape);
-		} else {
-			if (i)
-				len += pdu_decode_7bit_char(dest, len,
-				                            (data[i - 1] >> (7 + 1 - pos)) |
-				                            ((data[i] << pos) & 0x7f), &escape);
-
-			if (pos == 6)
-				len += pdu_decode_7bit_char(dest, len, (data[i] >> 1) & 0x7f,
-				                            &escape);
-		}
-	}
-	dest[len] = 0;
-	fprintf(stderr, "\n");
-	return len;
-}
-
-static int decode_udh(const unsigned char *data)
+static int decode_udh(struct blob_buf *buf, const unsigned char *data)
 {
 	const unsigned char *end;
 	unsigned int type, len, udh_len;
@@ -202,14 +122,14 @@ static int decode_udh(const unsigned char *data)
 
 		switch (type) {
 		case 0x00:
-			blobmsg_add_u32(&status, "concat_ref", (uint32_t) val[0]);
-			blobmsg_add_u32(&status, "concat_part", (uint32_t) val[2]);
-			blobmsg_add_u32(&status, "concat_parts", (uint32_t) val[1]);
+			blobmsg_add_u32(buf, "concat_ref", (uint32_t) val[0]);
+			blobmsg_add_u32(buf, "concat_part", (uint32_t) val[2]);
+			blobmsg_add_u32(buf, "concat_parts", (uint32_t) val[1]);
 			break;
 		case 0x08:
-			blobmsg_add_u32(&status, "concat_ref", (uint32_t) (val[0] << 8 | val[1]));
-			blobmsg_add_u32(&status, "concat_part", (uint32_t) val[3]);
-			blobmsg_add_u32(&status, "concat_parts", (uint32_t) val[2]);
+			blobmsg_add_u32(buf, "concat_ref", (uint32_t) (val[0] << 8 | val[1]));
+			blobmsg_add_u32(buf, "concat_part", (uint32_t) val[3]);
+			blobmsg_add_u32(buf, "concat_parts", (uint32_t) val[2]);
 			break;
 		default:
 			break;
@@ -219,12 +139,11 @@ static int decode_udh(const unsigned char *data)
 	return udh_len + 1;
 }
 
-static void decode_7bit_field(char *name, const unsigned char *data, int data_len, int bit_offset)
+static void decode_7bit_field(struct blob_buf *buf, char *name, const unsigned char *data, int data_len, int bit_offset)
 {
-	char *dest = blobmsg_alloc_string_buffer(&status, name, 3 * data_len + 2);
-	pdu_decode_7bit_str(dest, data, CEILDIV(data_len * 7, 8), bit_offset);
-	dest[data_len] = 0;
-	blobmsg_add_string_buffer(&status);
+	char *dest = blobmsg_alloc_string_buffer(buf, name, 3 * data_len + 2);
+	gsm7_decode(dest, data, data_len, bit_offset);
+	blobmsg_add_string_buffer(buf);
 }
 
 static char *pdu_add_semioctet(char *str, char val)
@@ -248,7 +167,7 @@ pdu_decode_address(char *str, unsigned char *data, int len)
 	toa = *(data++);
 	switch (toa & 0x70) {
 	case 0x50:
-		pdu_decode_7bit_str(str, data, len, 0);
+		gsm7_decode(str, data, len * 8 / 7, 0);
 		return;
 	case 0x10:
 		*(str++) = '+';
@@ -263,11 +182,11 @@ pdu_decode_address(char *str, unsigned char *data, int len)
 	*str = 0;
 }
 
-static void wms_decode_address(char *name, unsigned char *data, int len)
+static void wms_decode_address(struct blob_buf *buf, char *name, unsigned char *data, int len)
 {
-	char *str = blobmsg_alloc_string_buffer(&status, name, len * 2 + 2);
+	char *str = blobmsg_alloc_string_buffer(buf, name, len * 4 + 2);
 	pdu_decode_address(str, data, len);
-	blobmsg_add_string_buffer(&status);
+	blobmsg_add_string_buffer(buf);
 }
 
 static void blobmsg_add_hex(struct blob_buf *buf, const char *name, unsigned const char *data, int len)
@@ -297,6 +216,7 @@ cmd_wms_delete_message_prepare(struct qmi_dev *qmi, struct qmi_request *req, str
 		QMI_INIT(message_mode, QMI_WMS_MESSAGE_MODE_GSM_WCDMA),
 	};
 
+	mreq.data.memory_storage = wms_storage;
 	mreq.set.memory_index = 1;
 	mreq.data.memory_index = id;
 
@@ -306,27 +226,23 @@ cmd_wms_delete_message_prepare(struct qmi_dev *qmi, struct qmi_request *req, str
 }
 
 
-static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+static void wms_decode_message(struct blob_buf *buf, unsigned char *data, int len)
 {
-	struct qmi_wms_raw_read_response res;
-	unsigned char *data, *end;
+	unsigned char *end = data + len;
 	char *str;
 	int cur_len;
 	bool sent;
 	unsigned char first, dcs;
 	void *c;
 
-	qmi_parse_wms_raw_read_response(msg, &res);
-	c = blobmsg_open_table(&status, NULL);
-	data = (unsigned char *) res.data.raw_message_data.raw_data;
-	end = data + res.data.raw_message_data.raw_data_n;
+	c = blobmsg_open_table(buf, NULL);
 
 	cur_len = *(data++);
 	if (data + cur_len >= end)
 		goto error;
 
 	if (cur_len) {
-		wms_decode_address("smsc", data, cur_len - 1);
+		wms_decode_address(buf, "smsc", data, cur_len - 1);
 		data += cur_len;
 	}
 
@@ -344,7 +260,7 @@ static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req,
 
 	if (cur_len) {
 		cur_len = (cur_len + 1) / 2;
-		wms_decode_address(sent ? "receiver" : "sender", data, cur_len);
+		wms_decode_address(buf, sent ? "receiver" : "sender", data, cur_len);
 		data += cur_len + 1;
 	}
 
@@ -359,7 +275,7 @@ static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req,
 	dcs = *(data++);
 
 	if (dcs & 0x10)
-		blobmsg_add_u32(&status, "class", (dcs & 3));
+		blobmsg_add_u32(buf, "class", (dcs & 3));
 
 	if (sent) {
 		/* Message validity */
@@ -368,7 +284,7 @@ static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req,
 		if (data + 6 >= end)
 			goto error;
 
-		str = blobmsg_alloc_string_buffer(&status, "timestamp", 32);
+		str = blobmsg_alloc_string_buffer(buf, "timestamp", 32);
 
 		/* year */
 		*(str++) = '2';
@@ -392,7 +308,7 @@ static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req,
 		str = pdu_add_semioctet(str, data[5]);
 		*str = 0;
 
-		blobmsg_add_string_buffer(&status);
+		blobmsg_add_string_buffer(buf);
 
 		data += 7;
 	}
@@ -403,10 +319,11 @@ static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req,
 
 	/* User Data Header */
 	if (first & 0x40) {
-		udh_len = decode_udh(data);
+		udh_len = decode_udh(buf, data);
 		data += udh_len;
-		bit_offset = udh_len % 7;
-		}
+		/* fill bits up to the next septet boundary */
+		bit_offset = CEILDIV(udh_len * 8, 7) * 7 - udh_len * 8;
+	}
 
 	if (data >= end)
 		goto error;
@@ -415,31 +332,42 @@ static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req,
 		case 0x00:
 			/* 7 bit GSM alphabet */
 			message_len = message_len - CEILDIV(udh_len * 8, 7);
-			message_len = MIN(message_len, CEILDIV((end - data) * 8, 7));
-			decode_7bit_field("text", data, message_len, bit_offset);
+			message_len = MIN(message_len, ((end - data) * 8 - bit_offset) / 7);
+			if (message_len < 0)
+				goto error;
+			decode_7bit_field(buf, "text", data, message_len, bit_offset);
 			break;
 		case 0x04:
 			/* 8 bit data */
 			message_len = MIN(message_len - udh_len, end - data);
-			blobmsg_add_hex(&status, "data", data, message_len);
+			blobmsg_add_hex(buf, "data", data, message_len);
 			break;
 		case 0x08:
 			/* 16 bit UCS-2 string */
 			message_len = MIN(message_len - udh_len, end - data);
-			blobmsg_add_hex(&status, "ucs-2", data, message_len);
+			blobmsg_add_hex(buf, "ucs-2", data, message_len);
 			break;
 		default:
 			goto error;
 		}
 
-	blobmsg_close_table(&status, c);
+	blobmsg_close_table(buf, c);
 	return;
 
 error:
-	blobmsg_close_table(&status, c);
+	blobmsg_close_table(buf, c);
 	fprintf(stderr, "There was an error reading message.\n");
 }
 
+static void cmd_wms_get_message_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wms_raw_read_response res;
+
+	qmi_parse_wms_raw_read_response(msg, &res);
+	wms_decode_message(&status, res.data.raw_message_data.raw_data,
+			   res.data.raw_message_data.raw_data_n);
+}
+
 static enum qmi_cmd_result
 cmd_wms_get_message_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
 {
@@ -458,6 +386,7 @@ cmd_wms_get_message_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct
 		return QMI_CMD_EXIT;
 	}
 
+	mreq.data.message_memory_storage_id.storage_type = wms_storage;
 	mreq.data.message_memory_storage_id.memory_index = id;
 	qmi_set_wms_raw_read_request(msg, &mreq);
 
@@ -465,204 +394,1416 @@ cmd_wms_get_message_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct
 }
 
 
-static void cmd_wms_get_raw_message_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+#define WMS_READ_WINDOW		8
+
+static struct wms_message {
+	struct qmi_request req;
+	uint32_t index;
+	struct blob_attr *data;
+} *wms_messages;
+static int wms_n_messages;
+
+static void wms_free_messages(void)
 {
-	struct qmi_wms_raw_read_response res;
-	unsigned char *data;
-	char *str;
 	int i;
 
-	qmi_parse_wms_raw_read_response(msg, &res);
-	data = (unsigned char *) res.data.raw_message_data.raw_data;
-	str = blobmsg_alloc_string_buffer(&status, NULL, res.data.raw_message_data.raw_data_n * 3);
-	for (i = 0; i < res.data.raw_message_data.raw_data_n; i++) {
-		str += sprintf(str, &" %02x"[i ? 0 : 1], data[i]);
-	}
-	blobmsg_add_string_buffer(&status);
+	for (i = 0; i < wms_n_messages; i++)
+		free(wms_messages[i].data);
+	free(wms_messages);
+	wms_messages = NULL;
+	wms_n_messages = 0;
 }
 
-#define cmd_wms_get_raw_message_prepare cmd_wms_get_message_prepare
-
-
-static struct {
-	const char *smsc;
-	const char *target;
-	bool flash;
-} _send;
+static void wms_list_all_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wms_list_messages_response res;
+	int i;
 
+	qmi_parse_wms_list_messages_response(msg, &res);
+	wms_messages = calloc(res.data.message_list_n, sizeof(*wms_messages));
+	if (!wms_messages)
+		return;
 
-#define cmd_wms_send_message_smsc_cb no_cb
-static enum qmi_cmd_result
-cmd_wms_send_message_smsc_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
-{
-	_send.smsc = arg;
-	return QMI_CMD_DONE;
+	wms_n_messages = res.data.message_list_n;
+	for (i = 0; i < wms_n_messages; i++)
+		wms_messages[i].index = res.data.message_list[i].memory_index;
 }
 
-#define cmd_wms_send_message_target_cb no_cb
-static enum qmi_cmd_result
-cmd_wms_send_message_target_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+/* decode a message on a separate buffer, keeping a copy of the result */
+static void wms_read_message_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
 {
-	_send.target = arg;
-	return QMI_CMD_DONE;
+	struct wms_message *m = container_of(req, struct wms_message, req);
+	struct qmi_wms_raw_read_response res;
+	struct blob_buf buf = {};
+
+	qmi_parse_wms_raw_read_response(msg, &res);
+	blob_buf_init(&buf, 0);
+	wms_decode_message(&buf, res.data.raw_message_data.raw_data,
+			   res.data.raw_message_data.raw_data_n);
+	m->data = blob_memdup(blob_data(buf.head));
+	blob_buf_free(&buf);
 }
 
-#define cmd_wms_send_message_flash_cb no_cb
-static enum qmi_cmd_result
-cmd_wms_send_message_flash_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+/* list the messages in the selected storage, all of them unless a tag was given */
+static int wms_list_all(struct qmi_dev *qmi, struct qmi_msg *msg)
 {
-	_send.flash = true;
-	return QMI_CMD_DONE;
+	static struct qmi_wms_list_messages_request lreq = {
+		QMI_INIT(storage_type, QMI_WMS_STORAGE_TYPE_UIM),
+	};
+	struct qmi_request req;
+
+	wms_free_messages();
+
+	lreq.data.storage_type = wms_storage;
+	lreq.set.message_tag = wms_tag >= 0;
+	if (wms_tag >= 0)
+		lreq.data.message_tag = wms_tag;
+
+	qmi_set_wms_list_messages_request(msg, &lreq);
+	qmi_request_start(qmi, &req, wms_list_all_cb);
+	req.no_error_cb = true;
+	return qmi_request_wait(qmi, &req);
 }
 
-static int
-pdu_encode_semioctet(unsigned char *dest, const char *str)
+/*
+ * List all stored messages and read them with up to WMS_READ_WINDOW raw
+ * read requests in flight at a time.
+ */
+static int wms_read_messages(struct qmi_dev *qmi, struct qmi_msg *msg)
 {
-	int len = 0;
-	bool lower = true;
+	static struct qmi_wms_raw_read_request rreq = {
+		QMI_INIT_SEQUENCE(message_memory_storage_id,
+			.storage_type = QMI_WMS_STORAGE_TYPE_UIM,
+		),
+		QMI_INIT(message_mode, QMI_WMS_MESSAGE_MODE_GSM_WCDMA),
+	};
+	int i, ret;
 
-	while (*str) {
-		char digit = *str - '0';
+	ret = wms_list_all(qmi, msg);
+	if (ret)
+		return ret;
 
-		if (lower)
-			dest[len] = 0xf0 | digit;
-		else
-			dest[len++] &= (digit << 4) | 0xf;
+	rreq.data.message_memory_storage_id.storage_type = wms_storage;
+	for (i = 0; i < wms_n_messages; i++) {
+		if (i >= WMS_READ_WINDOW)
+			qmi_request_wait(qmi, &wms_messages[i - WMS_READ_WINDOW].req);
 
-		lower = !lower;
-		str++;
+		rreq.data.message_memory_storage_id.memory_index = wms_messages[i].index;
+		qmi_set_wms_raw_read_request(msg, &rreq);
+		qmi_request_start(qmi, &wms_messages[i].req, wms_read_message_cb);
+		wms_messages[i].req.no_error_cb = true;
 	}
 
-	return lower ? len : (len + 1);
+	for (i = 0; i < wms_n_messages; i++)
+		qmi_request_wait(qmi, &wms_messages[i].req);
+
+	return 0;
 }
 
-static int
-pdu_encode_7bit_str(unsigned char *data, const char *str)
+#define cmd_wms_get_all_messages_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_get_all_messages_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
 {
-	unsigned char c;
-	int len = 0;
-	int ofs = 0;
+	void *c, *t;
+	int i, ret;
 
-	while(1) {
-		c = *(str++) & 0x7f;
-		if (!c)
-			break;
+	ret = wms_read_messages(qmi, msg);
+	if (ret)
+		return uqmi_add_error(qmi_get_error_str(ret));
 
-		switch(ofs) {
-		case 0:
-			data[len] = c;
-			break;
-		default:
-			data[len++] |= c << (8 - ofs);
-			data[len] = c >> ofs;
-			break;
-		}
+	c = blobmsg_open_array(&status, NULL);
+	for (i = 0; i < wms_n_messages; i++) {
+		struct blob_attr *data = wms_messages[i].data;
+
+		if (!data)
+			continue;
 
-		ofs = (ofs + 1) % 8;
+		t = blobmsg_open_table(&status, NULL);
+		blobmsg_add_u32(&status, "index", wms_messages[i].index);
+		blob_put_raw(&status, blobmsg_data(data), blobmsg_data_len(data));
+		blobmsg_close_table(&status, t);
 	}
+	blobmsg_close_array(&status, c);
 
-	return len + 1;
+	wms_free_messages();
+	return QMI_CMD_DONE;
 }
 
-static int
-pdu_encode_number(unsigned char *dest, const char *str, bool smsc)
+static void wms_add_delete_result(void)
 {
-	unsigned char format;
-	bool ascii = false;
-	int len = 0;
+	void *c;
 	int i;
 
-	dest[len++] = 0;
-	if (*str == '+') {
-		str++;
-		format = 0x91;
-	} else {
-		format = 0x81;
-	}
+	c = blobmsg_open_array(&status, "deleted");
+	for (i = 0; i < wms_n_messages; i++)
+		if (!wms_messages[i].req.ret)
+			blobmsg_add_u32(&status, NULL, wms_messages[i].index);
+	blobmsg_close_array(&status, c);
 
-	for (i = 0; str[i]; i++) {
-		if (str[i] >= '0' && str[i] <= '9')
-			continue;
+	for (i = 0; i < wms_n_messages; i++)
+		if (wms_messages[i].req.ret)
+			break;
 
-		ascii = true;
-		break;
-	}
+	if (i == wms_n_messages)
+		return;
 
-	if (ascii)
-		format |= 0x40;
+	c = blobmsg_open_array(&status, "failed");
+	for (i = 0; i < wms_n_messages; i++)
+		if (wms_messages[i].req.ret)
+			blobmsg_add_u32(&status, NULL, wms_messages[i].index);
+	blobmsg_close_array(&status, c);
+}
 
-	dest[len++] = format;
-	if (!ascii)
-		len += pdu_encode_semioctet(&dest[len], str);
-	else
-		len += pdu_encode_7bit_str(&dest[len], str);
+/* delete the listed messages one by one, up to WMS_READ_WINDOW at a time */
+static void wms_delete_listed(struct qmi_dev *qmi, struct qmi_msg *msg)
+{
+	static struct qmi_wms_delete_request dreq = {
+		QMI_INIT(memory_storage, QMI_WMS_STORAGE_TYPE_UIM),
+		QMI_INIT(memory_index, 0),
+		QMI_INIT(message_mode, QMI_WMS_MESSAGE_MODE_GSM_WCDMA),
+	};
+	int i;
 
-	if (smsc)
-		dest[0] = len - 1;
-	else
-		dest[0] = strlen(str);
+	dreq.data.memory_storage = wms_storage;
+	for (i = 0; i < wms_n_messages; i++) {
+		if (i >= WMS_READ_WINDOW)
+			qmi_request_wait(qmi, &wms_messages[i - WMS_READ_WINDOW].req);
 
-	return len;
+		dreq.data.memory_index = wms_messages[i].index;
+		qmi_set_wms_delete_request(msg, &dreq);
+		qmi_request_start(qmi, &wms_messages[i].req, NULL);
+		wms_messages[i].req.no_error_cb = true;
+	}
+
+	for (i = 0; i < wms_n_messages; i++)
+		qmi_request_wait(qmi, &wms_messages[i].req);
 }
 
-static int
-pdu_encode_data(unsigned char *dest, const char *str)
+/*
+ * Delete everything in the selected storage matching the tag with a single
+ * request. Modems that do not support that get one request per message.
+ */
+static int wms_delete_all(struct qmi_dev *qmi, struct qmi_msg *msg)
 {
-	int len = 0;
+	static struct qmi_wms_delete_request dreq = {
+		QMI_INIT(memory_storage, QMI_WMS_STORAGE_TYPE_UIM),
+		QMI_INIT(message_mode, QMI_WMS_MESSAGE_MODE_GSM_WCDMA),
+	};
+	struct qmi_request req;
+	int ret;
 
-	dest[len++] = 0;
-	len += pdu_encode_7bit_str(&dest[len], str);
-	dest[0] = strlen(str);
+	ret = wms_list_all(qmi, msg);
+	if (ret || !wms_n_messages)
+		return ret;
 
-	return len;
+	dreq.data.memory_storage = wms_storage;
+	dreq.set.message_tag = wms_tag >= 0;
+	if (wms_tag >= 0)
+		dreq.data.message_tag = wms_tag;
+
+	qmi_set_wms_delete_request(msg, &dreq);
+	qmi_request_start(qmi, &req, NULL);
+	req.no_error_cb = true;
+	ret = qmi_request_wait(qmi, &req);
+	if (ret == QMI_ERROR_CANCELLED || ret == QMI_ERROR_TIMEOUT)
+		return ret;
+
+	if (ret)
+		wms_delete_listed(qmi, msg);
+
+	return 0;
 }
 
-#define cmd_wms_send_message_cb no_cb
+#define cmd_wms_delete_messages_cb no_cb
 static enum qmi_cmd_result
-cmd_wms_send_message_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+cmd_wms_delete_messages_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
 {
-	static unsigned char buf[512];
-	static struct qmi_wms_raw_send_request mreq = {
-		QMI_INIT_SEQUENCE(raw_message_data,
-			.format = QMI_WMS_MESSAGE_FORMAT_GSM_WCDMA_POINT_TO_POINT,
-			.raw_data = buf,
-		),
-	};
-	unsigned char *cur = buf;
-	unsigned char first_octet = 0x11;
-	unsigned char protocol_id = 0x00;
-	unsigned char dcs = 0x00;
+	char *word, *err;
+	int n = 1, ret;
+	void *c;
 
-	if (!_send.target || !*_send.target) {
-		uqmi_add_error("Missing argument");
-		return QMI_CMD_EXIT;
+	wms_free_messages();
+
+	if (!strcmp(arg, "all")) {
+		ret = wms_delete_all(qmi, msg);
+		if (ret) {
+			wms_free_messages();
+			return uqmi_add_error(qmi_get_error_str(ret));
+		}
+		goto out;
 	}
 
-	if ((_send.smsc && strlen(_send.smsc) > 16) || strlen(_send.target) > 16 || strlen(arg) > 160) {
-		uqmi_add_error("Argument too long");
-		return QMI_CMD_EXIT;
+	for (word = arg; *word; word++)
+		if (*word == ',')
+			n++;
+
+	wms_messages = calloc(n, sizeof(*wms_messages));
+	if (!wms_messages)
+		return uqmi_add_error("Out of memory");
+
+	while ((word = strsep(&arg, ",")) != NULL) {
+		wms_messages[wms_n_messages++].index = strtoul(word, &err, 10);
+		if (!*word || *err) {
+			wms_free_messages();
+			return uqmi_add_error("Invalid message ID");
+		}
 	}
 
-	if (_send.flash)
-		dcs |= 0x10;
+	wms_delete_listed(qmi, msg);
 
-	if (!_send.smsc || !*_send.smsc)
-		*(cur++) = 0;
-	else
-		cur += pdu_encode_number(cur, _send.smsc, true);
+out:
+	c = blobmsg_open_table(&status, NULL);
+	wms_add_delete_result();
+	blobmsg_close_table(&status, c);
+	wms_free_messages();
 
-	*(cur++) = first_octet;
-	*(cur++) = 0; /* reference */
+	return QMI_CMD_DONE;
+}
 
-	cur += pdu_encode_number(cur, _send.target, false);
-	*(cur++) = protocol_id;
-	*(cur++) = dcs;
+enum {
+	WMS_MSG_SENDER,
+	WMS_MSG_TIMESTAMP,
+	WMS_MSG_CLASS,
+	WMS_MSG_CONCAT_REF,
+	WMS_MSG_CONCAT_PART,
+	WMS_MSG_CONCAT_PARTS,
+	WMS_MSG_TEXT,
+	WMS_MSG_UCS2,
+	WMS_MSG_DATA,
+	__WMS_MSG_MAX
+};
+
+static const struct blobmsg_policy wms_msg_policy[__WMS_MSG_MAX] = {
+	[WMS_MSG_SENDER] = { "sender", BLOBMSG_TYPE_STRING },
+	[WMS_MSG_TIMESTAMP] = { "timestamp", BLOBMSG_TYPE_STRING },
+	[WMS_MSG_CLASS] = { "class", BLOBMSG_TYPE_INT32 },
+	[WMS_MSG_CONCAT_REF] = { "concat_ref", BLOBMSG_TYPE_INT32 },
+	[WMS_MSG_CONCAT_PART] = { "concat_part", BLOBMSG_TYPE_INT32 },
+	[WMS_MSG_CONCAT_PARTS] = { "concat_parts", BLOBMSG_TYPE_INT32 },
+	[WMS_MSG_TEXT] = { "text", BLOBMSG_TYPE_STRING },
+	[WMS_MSG_UCS2] = { "ucs-2", BLOBMSG_TYPE_STRING },
+	[WMS_MSG_DATA] = { "data", BLOBMSG_TYPE_STRING },
+};
+
+static void wms_parse_message(struct wms_message *m, struct blob_attr **tb)
+{
+	blobmsg_parse(wms_msg_policy, __WMS_MSG_MAX, tb,
+		      m->data ? blobmsg_data(m->data) : NULL,
+		      m->data ? blobmsg_data_len(m->data) : 0);
+}
 
-	*(cur++) = 0xff; /* validity */
-	cur += pdu_encode_data(cur, arg);
+static bool wms_attr_equal(struct blob_attr *a, struct blob_attr *b)
+{
+	if (!a || !b)
+		return !a && !b;
 
-	mreq.data.raw_message_data.raw_data_n = cur - buf;
-	qmi_set_wms_raw_send_request(msg, &mreq);
+	return blobmsg_data_len(a) == blobmsg_data_len(b) &&
+	       !memcmp(blobmsg_data(a), blobmsg_data(b), blobmsg_data_len(a));
+}
 
-	return QMI_CMD_REQUEST;
+/* same sender and concatenation reference and number of parts */
+static bool wms_same_group(struct blob_attr **a, struct blob_attr **b)
+{
+	return wms_attr_equal(a[WMS_MSG_SENDER], b[WMS_MSG_SENDER]) &&
+	       wms_attr_equal(a[WMS_MSG_CONCAT_REF], b[WMS_MSG_CONCAT_REF]) &&
+	       wms_attr_equal(a[WMS_MSG_CONCAT_PARTS], b[WMS_MSG_CONCAT_PARTS]);
+}
+
+static void wms_add_joined_field(int field, int *parts, int n_parts)
+{
+	struct blob_attr *tb[__WMS_MSG_MAX];
+	int i, len = 0;
+	char *str;
+
+	for (i = 0; i < n_parts; i++) {
+		if (parts[i] < 0)
+			continue;
+
+		wms_parse_message(&wms_messages[parts[i]], tb);
+		if (tb[field])
+			len += strlen(blobmsg_get_string(tb[field]));
+	}
+
+	if (!len)
+		return;
+
+	str = blobmsg_alloc_string_buffer(&status, wms_msg_policy[field].name, len + 1);
+	for (i = 0; i < n_parts; i++) {
+		if (parts[i] < 0)
+			continue;
+
+		wms_parse_message(&wms_messages[parts[i]], tb);
+		if (tb[field])
+			str = stpcpy(str, blobmsg_get_string(tb[field]));
+	}
+	blobmsg_add_string_buffer(&status);
+}
+
+/*
+ * Output a concatenated message group, starting at message first. Parts are
+ * put in order by their part number; a group with missing parts is flagged
+ * as incomplete and the missing part numbers are listed.
+ */
+static void wms_add_message_group(int first, bool *done)
+{
+	struct blob_attr *tb[__WMS_MSG_MAX], *cur[__WMS_MSG_MAX];
+	int parts[256];
+	int i, n_parts = 1, part;
+	bool complete = true;
+	void *c, *a;
+
+	wms_parse_message(&wms_messages[first], tb);
+	if (tb[WMS_MSG_CONCAT_PARTS] && tb[WMS_MSG_CONCAT_PART])
+		n_parts = blobmsg_get_u32(tb[WMS_MSG_CONCAT_PARTS]);
+	if (n_parts < 1 || n_parts > ARRAY_SIZE(parts))
+		n_parts = 1;
+
+	for (i = 0; i < n_parts; i++)
+		parts[i] = -1;
+
+	for (i = first; i < wms_n_messages; i++) {
+		if (done[i])
+			continue;
+
+		wms_parse_message(&wms_messages[i], cur);
+		if (i != first && !wms_same_group(tb, cur))
+			continue;
+
+		part = 1;
+		if (n_parts > 1 && cur[WMS_MSG_CONCAT_PART])
+			part = blobmsg_get_u32(cur[WMS_MSG_CONCAT_PART]);
+		if (part < 1 || part > n_parts || parts[part - 1] >= 0)
+			continue;
+
+		parts[part - 1] = i;
+		done[i] = true;
+	}
+
+	for (i = 0; i < n_parts; i++)
+		if (parts[i] < 0)
+			complete = false;
+
+	c = blobmsg_open_table(&status, NULL);
+	for (i = 0; i < n_parts; i++) {
+		if (parts[i] < 0)
+			continue;
+
+		/* sender, time stamp and class of the first part that is there */
+		wms_parse_message(&wms_messages[parts[i]], cur);
+		if (cur[WMS_MSG_SENDER])
+			blobmsg_add_string(&status, "sender", blobmsg_get_string(cur[WMS_MSG_SENDER]));
+		if (cur[WMS_MSG_TIMESTAMP])
+			blobmsg_add_string(&status, "timestamp", blobmsg_get_string(cur[WMS_MSG_TIMESTAMP]));
+		if (cur[WMS_MSG_CLASS])
+			blobmsg_add_u32(&status, "class", blobmsg_get_u32(cur[WMS_MSG_CLASS]));
+		break;
+	}
+
+	wms_add_joined_field(WMS_MSG_TEXT, parts, n_parts);
+	wms_add_joined_field(WMS_MSG_UCS2, parts, n_parts);
+	wms_add_joined_field(WMS_MSG_DATA, parts, n_parts);
+
+	a = blobmsg_open_array(&status, "indexes");
+	for (i = 0; i < n_parts; i++)
+		if (parts[i] >= 0)
+			blobmsg_add_u32(&status, NULL, wms_messages[parts[i]].index);
+	blobmsg_close_array(&status, a);
+
+	if (n_parts > 1) {
+		blobmsg_add_u32(&status, "parts", n_parts);
+		blobmsg_add_u8(&status, "complete", complete);
+	}
+
+	if (!complete) {
+		a = blobmsg_open_array(&status, "missing");
+		for (i = 0; i < n_parts; i++)
+			if (parts[i] < 0)
+				blobmsg_add_u32(&status, NULL, i + 1);
+		blobmsg_close_array(&status, a);
+	}
+
+	blobmsg_close_table(&status, c);
+}
+
+#define cmd_wms_get_long_messages_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_get_long_messages_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	bool *done;
+	void *c;
+	int i, ret;
+
+	ret = wms_read_messages(qmi, msg);
+	if (ret)
+		return uqmi_add_error(qmi_get_error_str(ret));
+
+	done = calloc(wms_n_messages + 1, sizeof(*done));
+	if (!done)
+		return uqmi_add_error("Out of memory");
+
+	c = blobmsg_open_array(&status, NULL);
+	for (i = 0; i < wms_n_messages; i++) {
+		if (!done[i] && wms_messages[i].data)
+			wms_add_message_group(i, done);
+	}
+	blobmsg_close_array(&status, c);
+
+	free(done);
+	wms_free_messages();
+	return QMI_CMD_DONE;
+}
+
+static void cmd_wms_get_raw_message_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct qmi_wms_raw_read_response res;
+	unsigned char *data;
+	char *str;
+	int i;
+
+	qmi_parse_wms_raw_read_response(msg, &res);
+	data = (unsigned char *) res.data.raw_message_data.raw_data;
+	str = blobmsg_alloc_string_buffer(&status, NULL, res.data.raw_message_data.raw_data_n * 3);
+	for (i = 0; i < res.data.raw_message_data.raw_data_n; i++) {
+		str += sprintf(str, &" %02x"[i ? 0 : 1], data[i]);
+	}
+	blobmsg_add_string_buffer(&status);
+}
+
+#define cmd_wms_get_raw_message_prepare cmd_wms_get_message_prepare
+
+
+static void cmd_wms_get_routes_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	static const char *classes[] = {
+		[QMI_WMS_MESSAGE_CLASS_0] = "0",
+		[QMI_WMS_MESSAGE_CLASS_1] = "1",
+		[QMI_WMS_MESSAGE_CLASS_2] = "2",
+		[QMI_WMS_MESSAGE_CLASS_3] = "3",
+		[QMI_WMS_MESSAGE_CLASS_NONE] = "none",
+		[QMI_WMS_MESSAGE_CLASS_CDMA] = "cdma",
+	};
+	static const char *actions[] = {
+		[QMI_WMS_RECEIPT_ACTION_DISCARD] = "discard",
+		[QMI_WMS_RECEIPT_ACTION_STORE_AND_NOTIFY] = "store",
+		[QMI_WMS_RECEIPT_ACTION_TRANSFER_ONLY] = "transfer-only",
+		[QMI_WMS_RECEIPT_ACTION_TRANSFER_AND_ACK] = "transfer",
+	};
+	struct qmi_wms_get_routes_response res;
+	void *c, *t;
+	int i;
+
+	qmi_parse_wms_get_routes_response(msg, &res);
+	c = blobmsg_open_array(&status, NULL);
+	for (i = 0; i < res.data.route_list_n; i++) {
+		unsigned int class = res.data.route_list[i].message_class;
+		unsigned int action = res.data.route_list[i].receipt_action;
+
+		t = blobmsg_open_table(&status, NULL);
+		if (class < ARRAY_SIZE(classes) && classes[class])
+			blobmsg_add_string(&status, "class", classes[class]);
+		if (action < ARRAY_SIZE(actions) && actions[action])
+			blobmsg_add_string(&status, "action", actions[action]);
+
+		switch (res.data.route_list[i].storage) {
+		case QMI_WMS_STORAGE_TYPE_UIM:
+			blobmsg_add_string(&status, "storage", "uim");
+			break;
+		case QMI_WMS_STORAGE_TYPE_NV:
+			blobmsg_add_string(&status, "storage", "nv");
+			break;
+		default:
+			break;
+		}
+		blobmsg_close_table(&status, t);
+	}
+	blobmsg_close_array(&status, c);
+}
+
+static enum qmi_cmd_result
+cmd_wms_get_routes_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	qmi_set_wms_get_routes_request(msg);
+	return QMI_CMD_REQUEST;
+}
+
+/*
+ * Class 2 messages are SIM specific and always go to the UIM. With transfer
+ * routes, all other messages are passed on to the client in event report
+ * indications without being stored. The modem acknowledges them itself.
+ */
+#define cmd_wms_set_routes_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_set_routes_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	static const QmiWmsMessageClass classes[] = {
+		QMI_WMS_MESSAGE_CLASS_0,
+		QMI_WMS_MESSAGE_CLASS_1,
+		QMI_WMS_MESSAGE_CLASS_2,
+		QMI_WMS_MESSAGE_CLASS_3,
+		QMI_WMS_MESSAGE_CLASS_NONE,
+	};
+	static struct qmi_wms_set_routes_request sreq;
+	static __typeof__(*sreq.data.route_list) routes[ARRAY_SIZE(classes)];
+	QmiWmsReceiptAction action;
+	QmiWmsStorageType storage;
+	int i;
+
+	if (!strcmp(arg, "store")) {
+		action = QMI_WMS_RECEIPT_ACTION_STORE_AND_NOTIFY;
+		storage = wms_storage;
+	} else if (!strcmp(arg, "transfer")) {
+		action = QMI_WMS_RECEIPT_ACTION_TRANSFER_AND_ACK;
+		storage = QMI_WMS_STORAGE_TYPE_NONE;
+	} else {
+		return uqmi_add_error("Invalid SMS route");
+	}
+
+	for (i = 0; i < ARRAY_SIZE(classes); i++) {
+		routes[i].message_type = QMI_WMS_MESSAGE_TYPE_POINT_TO_POINT;
+		routes[i].message_class = classes[i];
+		routes[i].storage = storage;
+		routes[i].receipt_action = action;
+
+		if (classes[i] != QMI_WMS_MESSAGE_CLASS_2)
+			continue;
+
+		routes[i].storage = QMI_WMS_STORAGE_TYPE_UIM;
+		routes[i].receipt_action = QMI_WMS_RECEIPT_ACTION_STORE_AND_NOTIFY;
+	}
+
+	qmi_set_static_array(&sreq, route_list, routes);
+	qmi_set_wms_set_routes_request(msg, &sreq);
+
+	return QMI_CMD_REQUEST;
+}
+
+#define WMS_RECEIVE_QUEUE	32
+
+static struct {
+	struct qmi_indication ind;
+	bool delete;
+	bool pending;
+	int n_queued;
+	struct {
+		QmiWmsStorageType storage;
+		uint32_t index;
+	} queue[WMS_RECEIVE_QUEUE];
+} wms_recv;
+
+static void
+wms_event_report_ind_cb(struct qmi_dev *qmi, struct qmi_indication *ind, struct qmi_msg *msg)
+{
+	struct qmi_wms_event_report_indication res;
+	int n = wms_recv.n_queued;
+
+	qmi_parse_wms_event_report_indication(msg, &res);
+	if (res.set.mt_message) {
+		if (n == WMS_RECEIVE_QUEUE) {
+			fprintf(stderr, "Too many new messages, message %d left in storage\n",
+				res.data.mt_message.memory_index);
+			return;
+		}
+
+		wms_recv.queue[n].storage = res.data.mt_message.storage_type;
+		wms_recv.queue[n].index = res.data.mt_message.memory_index;
+		wms_recv.n_queued++;
+		wms_recv.pending = true;
+		uloop_end();
+		return;
+	}
+
+	if (!res.set.transfer_route_mt_message ||
+	    res.data.transfer_route_mt_message.format != QMI_WMS_MESSAGE_FORMAT_GSM_WCDMA_POINT_TO_POINT)
+		return;
+
+	wms_decode_message(&status, res.data.transfer_route_mt_message.raw_data,
+			   res.data.transfer_route_mt_message.raw_data_n);
+	uqmi_flush_json_line();
+}
+
+/*
+ * Read all messages announced since the last call in one batch, print them
+ * and delete them from storage if requested. Indications arriving in the
+ * meantime are queued for the next batch.
+ */
+static void wms_receive_stored(struct qmi_dev *qmi, struct qmi_msg *msg)
+{
+	static struct qmi_wms_raw_read_request rreq = {
+		QMI_INIT_SEQUENCE(message_memory_storage_id,
+			.storage_type = QMI_WMS_STORAGE_TYPE_UIM,
+		),
+		QMI_INIT(message_mode, QMI_WMS_MESSAGE_MODE_GSM_WCDMA),
+	};
+	static struct qmi_wms_delete_request dreq = {
+		QMI_INIT(memory_storage, QMI_WMS_STORAGE_TYPE_UIM),
+		QMI_INIT(memory_index, 0),
+		QMI_INIT(message_mode, QMI_WMS_MESSAGE_MODE_GSM_WCDMA),
+	};
+	struct wms_message msgs[WMS_RECEIVE_QUEUE] = {};
+	QmiWmsStorageType storage[WMS_RECEIVE_QUEUE];
+	int i, n = wms_recv.n_queued;
+	void *c;
+
+	for (i = 0; i < n; i++) {
+		storage[i] = wms_recv.queue[i].storage;
+		msgs[i].index = wms_recv.queue[i].index;
+	}
+	wms_recv.n_queued = 0;
+	wms_recv.pending = false;
+
+	for (i = 0; i < n; i++) {
+		rreq.data.message_memory_storage_id.storage_type = storage[i];
+		rreq.data.message_memory_storage_id.memory_index = msgs[i].index;
+		qmi_set_wms_raw_read_request(msg, &rreq);
+		qmi_request_start(qmi, &msgs[i].req, wms_read_message_cb);
+		msgs[i].req.no_error_cb = true;
+	}
+
+	for (i = 0; i < n; i++) {
+		qmi_request_wait(qmi, &msgs[i].req);
+		if (!msgs[i].data)
+			continue;
+
+		c = blobmsg_open_table(&status, NULL);
+		blobmsg_add_u32(&status, "index", msgs[i].index);
+		blob_put_raw(&status, blobmsg_data(msgs[i].data), blobmsg_data_len(msgs[i].data));
+		blobmsg_close_table(&status, c);
+		uqmi_flush_json_line();
+	}
+
+	for (i = 0; i < n; i++) {
+		if (!wms_recv.delete || !msgs[i].data)
+			continue;
+
+		dreq.data.memory_storage = storage[i];
+		dreq.data.memory_index = msgs[i].index;
+		qmi_set_wms_delete_request(msg, &dreq);
+		qmi_request_start(qmi, &msgs[i].req, NULL);
+		msgs[i].req.no_error_cb = true;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (wms_recv.delete && msgs[i].data)
+			qmi_request_wait(qmi, &msgs[i].req);
+		free(msgs[i].data);
+	}
+}
+
+#define cmd_wms_receive_messages_delete_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_receive_messages_delete_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	wms_recv.delete = true;
+	return QMI_CMD_DONE;
+}
+
+/*
+ * Print incoming messages as they arrive as a JSON Lines stream, one
+ * compact JSON object per line. Stored messages are read as soon as the
+ * modem announces them, messages on transfer routes come with the
+ * indication itself.
+ */
+#define cmd_wms_receive_messages_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_receive_messages_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	static struct qmi_wms_set_event_report_request ereq = {
+		QMI_INIT_SEQUENCE(new_mt_message_indicator,
+			.report = true,
+		),
+	};
+	int ret;
+
+	if (output_format != UQMI_OUTPUT_JSON)
+		return uqmi_add_error("Receiving messages requires JSON output");
+
+	qmi_indication_register(qmi, &wms_recv.ind, QMI_SERVICE_WMS,
+				QMI_WMS_EVENT_REPORT_INDICATION,
+				wms_event_report_ind_cb);
+
+	qmi_set_wms_set_event_report_request(msg, &ereq);
+	qmi_request_start(qmi, req, NULL);
+	ret = qmi_request_wait(qmi, req);
+	if (!ret) {
+		while (!qmi_device_wait(qmi, &wms_recv.pending, -1))
+			wms_receive_stored(qmi, msg);
+	}
+
+	qmi_indication_unregister(qmi, &wms_recv.ind);
+
+	if (ret)
+		return uqmi_add_error(qmi_get_error_str(ret));
+
+	return QMI_CMD_DONE;
+}
+
+static struct {
+	const char *smsc;
+	const char *target;
+	bool flash;
+} _send;
+
+
+#define cmd_wms_send_message_smsc_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_send_message_smsc_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	_send.smsc = arg;
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wms_send_message_target_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_send_message_target_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	_send.target = arg;
+	return QMI_CMD_DONE;
+}
+
+#define cmd_wms_send_message_flash_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_send_message_flash_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	_send.flash = true;
+	return QMI_CMD_DONE;
+}
+
+static int
+pdu_encode_semioctet(unsigned char *dest, const char *str)
+{
+	int len = 0;
+	bool lower = true;
+
+	while (*str) {
+		char digit = *str - '0';
+
+		if (lower)
+			dest[len] = 0xf0 | digit;
+		else
+			dest[len++] &= (digit << 4) | 0xf;
+
+		lower = !lower;
+		str++;
+	}
+
+	return lower ? len : (len + 1);
+}
+
+static int
+pdu_encode_7bit_str(unsigned char *data, const char *str)
+{
+	uint8_t septets[16];
+	int c, n = 0;
+
+	for (; *str && n < ARRAY_SIZE(septets); str++) {
+		c = gsm7_encode_char((unsigned char) *str);
+		septets[n++] = c < 0 || c > 0x7f ? '?' : c;
+	}
+
+	memset(data, 0, CEILDIV(n * 7, 8));
+	gsm7_pack(data, septets, n, 0);
+
+	return CEILDIV(n * 7, 8);
+}
+
+static int
+pdu_encode_number(unsigned char *dest, const char *str, bool smsc)
+{
+	unsigned char format;
+	bool ascii = false;
+	int len = 0;
+	int i;
+
+	dest[len++] = 0;
+	if (*str == '+') {
+		str++;
+		format = 0x91;
+	} else {
+		format = 0x81;
+	}
+
+	for (i = 0; str[i]; i++) {
+		if (str[i] >= '0' && str[i] <= '9')
+			continue;
+
+		ascii = true;
+		break;
+	}
+
+	if (ascii)
+		format |= 0x40;
+
+	dest[len++] = format;
+	if (!ascii)
+		len += pdu_encode_semioctet(&dest[len], str);
+	else
+		len += pdu_encode_7bit_str(&dest[len], str);
+
+	if (smsc)
+		dest[0] = len - 1;
+	else
+		dest[0] = strlen(str);
+
+	return len;
+}
+
+#define WMS_PDU_SIZE		256
+#define WMS_SEGMENTS_MAX	255
+
+/* decode UTF-8 into UTF-16 code units, invalid sequences become U+FFFD */
+static int
+wms_utf8_to_utf16(uint16_t *dest, const char *str)
+{
+	const unsigned char *s = (const unsigned char *) str;
+	uint32_t c;
+	int n = 0, len, i;
+
+	while (*s) {
+		c = *s;
+		len = c < 0x80 ? 0 : c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : -1;
+		if (len > 0)
+			c &= 0x3f >> len;
+		s++;
+
+		for (i = 0; i < len; i++, s++) {
+			if ((*s & 0xc0) != 0x80)
+				break;
+			c = (c << 6) | (*s & 0x3f);
+		}
+
+		if (len < 0 || i < len || c > 0x10ffff)
+			c = 0xfffd;
+
+		if (c >= 0x10000) {
+			c -= 0x10000;
+			dest[n++] = 0xd800 | (c >> 10);
+			dest[n++] = 0xdc00 | (c & 0x3ff);
+		} else {
+			dest[n++] = c;
+		}
+	}
+
+	return n;
+}
+
+struct wms_segment {
+	int start;
+	int len;
+};
+
+/*
+ * Split text into segments of at most seg_max units, or a single one of up
+ * to single_max units. Escape sequences and surrogate pairs stay together.
+ */
+static int
+wms_split_text(struct wms_segment *seg, const uint16_t *units, int n,
+	       int single_max, int seg_max, bool ucs2)
+{
+	int n_seg = 0, start = 0, len;
+
+	if (n <= single_max) {
+		seg[0].start = 0;
+		seg[0].len = n;
+		return 1;
+	}
+
+	while (start < n) {
+		if (n_seg == WMS_SEGMENTS_MAX)
+			return -1;
+
+		len = MIN(seg_max, n - start);
+		if (start + len < n) {
+			if (ucs2 && (units[start + len - 1] & 0xfc00) == 0xd800)
+				len--;
+			else if (!ucs2 && units[start + len - 1] == 0x1b)
+				len--;
+		}
+
+		seg[n_seg].start = start;
+		seg[n_seg++].len = len;
+		start += len;
+	}
+
+	return n_seg;
+}
+
+static int
+wms_encode_header(unsigned char *buf, const char *target, bool udh, bool ucs2)
+{
+	unsigned char *cur = buf;
+	unsigned char first_octet = 0x11;
+	unsigned char protocol_id = 0x00;
+	unsigned char dcs = ucs2 ? 0x08 : 0x00;
+
+	if (udh)
+		first_octet |= 0x40;
+
+	if (_send.flash)
+		dcs |= 0x10;
+
+	if (!_send.smsc || !*_send.smsc)
+		*(cur++) = 0;
+	else
+		cur += pdu_encode_number(cur, _send.smsc, true);
+
+	*(cur++) = first_octet;
+	*(cur++) = 0; /* reference */
+
+	cur += pdu_encode_number(cur, target, false);
+	*(cur++) = protocol_id;
+	*(cur++) = dcs;
+
+	*(cur++) = 0xff; /* validity */
+
+	return cur - buf;
+}
+
+#define WMS_SEND_WINDOW		4
+#define WMS_SEND_TRIES		3
+#define WMS_SEND_RETRY_DELAY	2000
+
+enum wms_send_state {
+	WMS_SEND_IDLE,		/* not sent yet, or due for a retry */
+	WMS_SEND_PENDING,	/* request in flight */
+	WMS_SEND_RETRY,		/* waiting for the retry timer */
+	WMS_SEND_DONE,
+};
+
+struct wms_send_msg {
+	struct qmi_request req;
+	struct uloop_timeout retry;
+	enum wms_send_state state;
+	char *target;
+	const char *err;
+	int line;
+	int part;
+	int tries;
+	bool has_id;
+	uint16_t message_id;
+	int len;
+	unsigned char pdu[WMS_PDU_SIZE];
+};
+
+static const char *
+wms_check_send_args(const char *target)
+{
+	if (!target || !*target)
+		return "Missing argument";
+
+	if ((_send.smsc && strlen(_send.smsc) > 16) || strlen(target) > 16)
+		return "Argument too long";
+
+	return NULL;
+}
+
+/*
+ * Concatenation reference for the next multipart message. Every uqmi run
+ * starts at a random value, so that the segments of messages sent by
+ * consecutive runs to the same recipient are not joined together.
+ */
+static uint8_t
+wms_next_concat_ref(void)
+{
+	static bool seeded;
+	static uint8_t ref;
+	FILE *f;
+
+	if (!seeded) {
+		f = fopen("/dev/urandom", "r");
+		if (!f || fread(&ref, sizeof(ref), 1, f) != 1)
+			ref = time(NULL) ^ getpid();
+		if (f)
+			fclose(f);
+		seeded = true;
+	}
+
+	return ref++;
+}
+
+/*
+ * Encode text for target and append the PDUs to the send list. Text that
+ * fits the GSM 7 bit alphabet is sent as such, anything else as UCS-2.
+ * Long texts are split into concatenated segments with a user data header.
+ * On errors, a single entry carrying the error is added.
+ */
+static int
+wms_send_add(struct wms_send_msg **list, int n, int line, const char *target, const char *text)
+{
+	struct wms_segment *seg = NULL;
+	struct wms_send_msg *q, *m;
+	uint16_t *units, *septets = NULL;
+	uint8_t packed[160];
+	const char *err;
+	int n_units, n_septets = 0, n_seg = 1;
+	int i, j, c, hdr, ud, bit;
+	uint8_t ref = 0;
+	bool ucs2 = false;
+
+	err = wms_check_send_args(target);
+	units = calloc(strlen(text) + 1, sizeof(*units));
+	if (!err && !units)
+		err = "Out of memory";
+
+	if (!err) {
+		n_units = wms_utf8_to_utf16(units, text);
+		septets = calloc(2 * n_units + 1, sizeof(*septets));
+		seg = calloc(WMS_SEGMENTS_MAX, sizeof(*seg));
+		if (!septets || !seg)
+			err = "Out of memory";
+	}
+
+	if (!err) {
+		for (i = 0; i < n_units; i++) {
+			c = gsm7_encode_char(units[i]);
+			if (c < 0) {
+				ucs2 = true;
+				break;
+			}
+
+			if (c > 0x7f)
+				septets[n_septets++] = 0x1b;
+			septets[n_septets++] = c & 0x7f;
+		}
+
+		if (ucs2)
+			n_seg = wms_split_text(seg, units, n_units, 70, 67, true);
+		else
+			n_seg = wms_split_text(seg, septets, n_septets, 160, 153, false);
+		if (n_seg < 0)
+			err = "Message too long";
+	}
+
+	q = realloc(*list, (n + (err ? 1 : n_seg)) * sizeof(*q));
+	if (!q) {
+		n_seg = 0;
+		goto out;
+	}
+	*list = q;
+
+	if (err) {
+		m = &q[n++];
+		memset(m, 0, sizeof(*m));
+		m->line = line;
+		m->target = strdup(target ? target : "");
+		m->err = err;
+		goto out;
+	}
+
+	if (n_seg > 1)
+		ref = wms_next_concat_ref();
+
+	for (i = 0; i < n_seg; i++) {
+		m = &q[n++];
+		memset(m, 0, sizeof(*m));
+		m->line = line;
+		m->part = n_seg > 1 ? i + 1 : 0;
+		m->target = strdup(target);
+
+		hdr = wms_encode_header(m->pdu, target, n_seg > 1, ucs2);
+		ud = hdr + 1;
+		if (n_seg > 1) {
+			m->pdu[ud++] = 5;	/* header length */
+			m->pdu[ud++] = 0x00;	/* concatenated message, 8 bit reference */
+			m->pdu[ud++] = 3;
+			m->pdu[ud++] = ref;
+			m->pdu[ud++] = n_seg;
+			m->pdu[ud++] = i + 1;
+		}
+
+		if (ucs2) {
+			for (j = 0; j < seg[i].len; j++) {
+				m->pdu[ud++] = units[seg[i].start + j] >> 8;
+				m->pdu[ud++] = units[seg[i].start + j] & 0xff;
+			}
+			m->pdu[hdr] = ud - hdr - 1;
+			m->len = ud;
+			continue;
+		}
+
+		/* septets start at the next septet boundary after the header */
+		bit = CEILDIV((ud - hdr - 1) * 8, 7) * 7;
+		for (j = 0; j < seg[i].len; j++)
+			packed[j] = septets[seg[i].start + j];
+		gsm7_pack(&m->pdu[hdr + 1 + bit / 8], packed, seg[i].len, bit % 8);
+
+		bit += 7 * seg[i].len;
+		m->pdu[hdr] = bit / 7;
+		m->len = hdr + 1 + CEILDIV(bit, 8);
+	}
+
+out:
+	free(seg);
+	free(septets);
+	free(units);
+
+	return n;
+}
+
+static void wms_send_msg_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct wms_send_msg *m = container_of(req, struct wms_send_msg, req);
+	struct qmi_wms_raw_send_response res;
+
+	qmi_parse_wms_raw_send_response(msg, &res);
+	m->has_id = res.set.message_id;
+	m->message_id = res.data.message_id;
+}
+
+/* errors that may go away when the message is sent again a bit later */
+static bool wms_send_error_transient(int ret)
+{
+	switch (ret) {
+	case QMI_PROTOCOL_ERROR_NO_MEMORY:
+	case QMI_PROTOCOL_ERROR_DEVICE_NOT_READY:
+	case QMI_PROTOCOL_ERROR_NETWORK_NOT_READY:
+	case QMI_PROTOCOL_ERROR_NETWORK_ABORTED:
+	case QMI_PROTOCOL_ERROR_WMS_MESSAGE_NOT_SENT:
+	case QMI_PROTOCOL_ERROR_WMS_MESSAGE_DELIVERY_FAILURE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool wms_send_event;
+
+static void wms_send_retry_cb(struct uloop_timeout *t)
+{
+	struct wms_send_msg *m = container_of(t, struct wms_send_msg, retry);
+
+	m->state = WMS_SEND_IDLE;
+	wms_send_event = true;
+	uloop_end();
+}
+
+static void wms_send_start(struct qmi_dev *qmi, struct qmi_msg *msg, struct wms_send_msg *m)
+{
+	struct qmi_wms_raw_send_request mreq = {
+		QMI_INIT_SEQUENCE(raw_message_data,
+			.format = QMI_WMS_MESSAGE_FORMAT_GSM_WCDMA_POINT_TO_POINT,
+			.raw_data = m->pdu,
+			.raw_data_n = m->len,
+		),
+	};
+
+	m->tries++;
+	m->state = WMS_SEND_PENDING;
+	qmi_set_wms_raw_send_request(msg, &mreq);
+	qmi_request_start(qmi, &m->req, wms_send_msg_cb);
+	m->req.no_error_cb = true;
+	m->req.complete = &wms_send_event;
+}
+
+/* a send request completed: done, or schedule it to be sent again */
+static void wms_send_complete(struct wms_send_msg *m)
+{
+	if (!m->req.ret || cancel_all_requests || m->tries >= WMS_SEND_TRIES ||
+	    !wms_send_error_transient(m->req.ret)) {
+		m->state = WMS_SEND_DONE;
+		return;
+	}
+
+	m->state = WMS_SEND_RETRY;
+	m->retry.cb = wms_send_retry_cb;
+	uloop_timeout_set(&m->retry, WMS_SEND_RETRY_DELAY);
+}
+
+/*
+ * Send a list of PDUs on one WMS client, with up to WMS_SEND_WINDOW
+ * messages in flight or waiting for a retry. PDUs failing with a transient
+ * error are sent again once their own retry delay has passed, up to
+ * WMS_SEND_TRIES times in total, while the other slots keep sending.
+ * Returns the number of list entries that were processed.
+ */
+static int wms_send_run(struct qmi_dev *qmi, struct qmi_msg *msg, struct wms_send_msg *q, int n)
+{
+	struct wms_send_msg *m;
+	int active, next = 0, i;
+
+	do {
+		active = 0;
+		for (i = 0; i < next; i++) {
+			m = &q[i];
+			if (m->state == WMS_SEND_PENDING && !m->req.pending)
+				wms_send_complete(m);
+
+			if (m->state == WMS_SEND_IDLE)
+				wms_send_start(qmi, msg, m);
+
+			if (m->state != WMS_SEND_DONE)
+				active++;
+		}
+
+		while (active < WMS_SEND_WINDOW && next < n && !cancel_all_requests) {
+			m = &q[next++];
+			if (m->err) {
+				m->state = WMS_SEND_DONE;
+				continue;
+			}
+
+			wms_send_start(qmi, msg, m);
+			active++;
+		}
+
+		wms_send_event = false;
+	} while (active && !qmi_device_wait(qmi, &wms_send_event, -1));
+
+	/* cancelled: drop the requests in flight and the pending retries */
+	for (i = 0; i < next; i++) {
+		m = &q[i];
+		if (m->state == WMS_SEND_PENDING)
+			qmi_request_cancel(qmi, &m->req);
+		else if (m->state == WMS_SEND_RETRY)
+			uloop_timeout_cancel(&m->retry);
+		m->state = WMS_SEND_DONE;
+	}
+
+	return next;
+}
+
+static void wms_send_free(struct wms_send_msg *q, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		free(q[i].target);
+	free(q);
+}
+
+#define cmd_wms_send_message_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_send_message_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	struct wms_send_msg *q = NULL;
+	const char *err = NULL;
+	int i, n, done;
+
+	n = wms_send_add(&q, 0, 0, _send.target, arg);
+	if (!n)
+		return uqmi_add_error("Out of memory");
+
+	if (q[0].err) {
+		uqmi_add_error(q[0].err);
+		wms_send_free(q, n);
+		return QMI_CMD_EXIT;
+	}
+
+	done = wms_send_run(qmi, msg, q, n);
+	for (i = 0; i < n && !err; i++) {
+		if (i >= done)
+			err = qmi_get_error_str(QMI_ERROR_CANCELLED);
+		else if (q[i].req.ret)
+			err = qmi_get_error_str(q[i].req.ret);
+	}
+	wms_send_free(q, n);
+
+	if (err)
+		return uqmi_add_error(err);
+
+	return QMI_CMD_DONE;
+}
+
+/*
+ * read "<nr> <text>" lines, skipping empty lines and comments. Returns the
+ * number of list entries, or -1 if the file could not be read completely.
+ */
+static int wms_send_queue_read(FILE *f, struct wms_send_msg **list)
+{
+	char *line = NULL, *text;
+	size_t size = 0;
+	ssize_t len;
+	int n = 0, nr = 0, ret;
+
+	while ((len = getline(&line, &size, f)) >= 0) {
+		nr++;
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+
+		if (!*line || *line == '#')
+			continue;
+
+		text = strchr(line, ' ');
+		if (text)
+			*(text++) = 0;
+		else
+			text = "";
+
+		/* nothing added: out of memory */
+		ret = wms_send_add(list, n, nr, line, text);
+		if (ret == n)
+			break;
+
+		n = ret;
+	}
+
+	free(line);
+
+	if (!feof(f)) {
+		wms_send_free(*list, n);
+		*list = NULL;
+		return -1;
+	}
+
+	return n;
+}
+
+static void wms_send_queue_add_result(struct wms_send_msg *m)
+{
+	void *c;
+
+	c = blobmsg_open_table(&status, NULL);
+	blobmsg_add_u32(&status, "line", m->line);
+	if (m->target)
+		blobmsg_add_string(&status, "target", m->target);
+	if (m->part)
+		blobmsg_add_u32(&status, "part", m->part);
+
+	if (m->err) {
+		blobmsg_add_string(&status, "error", m->err);
+	} else if (m->req.ret) {
+		blobmsg_add_string(&status, "error", qmi_get_error_str(m->req.ret));
+		blobmsg_add_u32(&status, "tries", m->tries);
+	} else {
+		blobmsg_add_string(&status, "result", "sent");
+		if (m->has_id)
+			blobmsg_add_u32(&status, "message_id", m->message_id);
+		blobmsg_add_u32(&status, "tries", m->tries);
+	}
+	blobmsg_close_table(&status, c);
+}
+
+/*
+ * Send all messages of a queue file in one batch. Every PDU is encoded
+ * before the first one is sent.
+ */
+#define cmd_wms_send_queue_cb no_cb
+static enum qmi_cmd_result
+cmd_wms_send_queue_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	struct wms_send_msg *q = NULL;
+	int i, n, done;
+	FILE *f;
+	void *c;
+
+	f = strcmp(arg, "-") ? fopen(arg, "r") : stdin;
+	if (!f)
+		return uqmi_add_error("Failed to open queue file");
+
+	n = wms_send_queue_read(f, &q);
+	if (f != stdin)
+		fclose(f);
+
+	if (n < 0)
+		return uqmi_add_error("Failed to read the whole queue file");
+
+	done = wms_send_run(qmi, msg, q, n);
+
+	c = blobmsg_open_array(&status, NULL);
+	for (i = 0; i < done; i++)
+		wms_send_queue_add_result(&q[i]);
+	blobmsg_close_array(&status, c);
+
+	wms_send_free(q, n);
+
+	return QMI_CMD_DONE;
 }
@@ -21,21 +21,47 @@
 
 #define __uqmi_wms_commands \
 	__uqmi_command(wms_list_messages, list-messages, no, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_storage, sms-storage, required, CMD_TYPE_OPTION), \
+	__uqmi_command(wms_tag, sms-tag, required, CMD_TYPE_OPTION), \
 	__uqmi_command(wms_delete_message, delete-message, required, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_delete_messages, delete-messages, required, QMI_SERVICE_WMS), \
 	__uqmi_command(wms_get_message, get-message, required, QMI_SERVICE_WMS), \
 	__uqmi_command(wms_get_raw_message, get-raw-message, required, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_get_all_messages, get-all-messages, no, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_get_long_messages, get-long-messages, no, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_get_routes, get-sms-routes, no, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_set_routes, set-sms-routes, required, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_receive_messages_delete, receive-messages-delete, no, CMD_TYPE_OPTION), \
+	__uqmi_command(wms_receive_messages, receive-messages, no, QMI_SERVICE_WMS), \
 	__uqmi_command(wms_send_message_smsc, send-message-smsc, required, CMD_TYPE_OPTION), \
 	__uqmi_command(wms_send_message_target, send-message-target, required, CMD_TYPE_OPTION), \
 	__uqmi_command(wms_send_message_flash, send-message-flash, no, CMD_TYPE_OPTION), \
-	__uqmi_command(wms_send_message, send-message, required, QMI_SERVICE_WMS)
+	__uqmi_command(wms_send_message, send-message, required, QMI_SERVICE_WMS), \
+	__uqmi_command(wms_send_queue, send-queue, required, QMI_SERVICE_WMS)
 
 #define wms_helptext \
 		"  --list-messages:                  List SMS messages\n" \
+		"    --sms-storage <storage>:        Message storage (uim, nv), default: uim\n" \
+		"    --sms-tag <tag>:                Only messages with tag (read, unread, sent, unsent, all)\n" \
+		"                                    default: unread for --list-messages, all otherwise\n" \
 		"  --delete-message <id>:            Delete SMS message at index <id>\n" \
+		"  --delete-messages <id>[,<id>...]: Delete SMS messages at the given indexes\n" \
+		"  --delete-messages all:            Delete all SMS messages (matching --sms-tag)\n" \
 		"  --get-message <id>:               Get SMS message at index <id>\n" \
 		"  --get-raw-message <id>:           Get SMS raw message contents at index <id>\n" \
+		"  --get-all-messages:               Get all SMS messages\n" \
+		"  --get-long-messages:              Get all SMS messages, joining concatenated parts\n" \
+		"  --get-sms-routes:                 Get the routes for incoming SMS messages\n" \
+		"  --set-sms-routes <route>:         Route incoming SMS messages (store, transfer)\n" \
+		"                                    transfer: pass messages on without storing them\n" \
+		"  --receive-messages:               Wait for incoming SMS messages and print them\n" \
+		"                                    as JSON Lines, one message per line\n" \
+		"    --receive-messages-delete:      Delete received messages from storage\n" \
 		"  --send-message <data>:            Send SMS message (use options below)\n" \
 		"    --send-message-smsc <nr>:       SMSC number\n" \
 		"    --send-message-target <nr>:     Destination number (required)\n" \
 		"    --send-message-flash:           Send as Flash SMS\n" \
+		"  --send-queue <file>:              Send SMS messages listed in <file> (- for stdin)\n" \
+		"                                    one \"<nr> <text>\" per line, uses the SMSC and\n" \
+		"                                    flash options of --send-message\n" \
 
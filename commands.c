@@ -24,15 +24,28 @@
 #include <strings.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
+#include <limits.h>
 
 #include <libubox/blobmsg.h>
 #include <libubox/blobmsg_json.h>
 
 #include "uqmi.h"
 #include "commands.h"
+#include "cache.h"
+#include "shm.h"
+#include "kpi.h"
+#include "output.h"
+#include "gsm7.h"
 
 static struct blob_buf status;
 bool single_line = false;
+enum uqmi_output_format output_format = UQMI_OUTPUT_JSON;
+static const char *result_name;
+
+static void uqmi_print_result(struct blob_attr *data);
+static void uqmi_flush_result(void);
+static void uqmi_flush_json_line(void);
 
 static void no_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
 {
@@ -171,6 +184,227 @@ cmd_ctl_set_data_format_prepare(struct qmi_dev *qmi, struct qmi_request *req, st
 #include "commands-wda.c"
 #include "commands-uim.c"
 
+enum {
+	STATUS_ALL_STATE = (1 << 0),
+	STATUS_ALL_IDENTITY = (1 << 1),
+	STATUS_ALL_COUNTERS = (1 << 2),
+};
+
+/*
+ * Each query uses the prepare function of the original command and the
+ * decoder behind its callback, which writes to the buffer it is given.
+ */
+static struct uqmi_status_all_req {
+	struct qmi_request req;
+	const char *name;
+	int cmd;
+	void (*decode)(struct blob_buf *buf, struct qmi_msg *msg);
+	int type;
+	bool started;
+} status_all_reqs[] = {
+	{ .name = "pin-status", .cmd = __UQMI_COMMAND_dms_get_pin_status,
+	  .decode = dms_decode_pin_status, .type = STATUS_ALL_STATE },
+	{ .name = "card-status", .cmd = __UQMI_COMMAND_uim_get_card_status,
+	  .decode = uim_decode_card_status, .type = STATUS_ALL_STATE },
+	{ .name = "serving-system", .cmd = __UQMI_COMMAND_nas_get_serving_system,
+	  .decode = nas_decode_serving_system, .type = STATUS_ALL_STATE },
+	{ .name = "signal-info", .cmd = __UQMI_COMMAND_nas_get_signal_info,
+	  .decode = nas_decode_signal_info, .type = STATUS_ALL_STATE },
+	{ .name = "data-status", .cmd = __UQMI_COMMAND_wds_get_packet_service_status,
+	  .decode = wds_decode_packet_service_status, .type = STATUS_ALL_STATE },
+	{ .name = "packet-statistics", .cmd = __UQMI_COMMAND_wds_get_packet_statistics,
+	  .decode = wds_decode_packet_statistics, .type = STATUS_ALL_COUNTERS },
+	{ .name = "imei", .cmd = __UQMI_COMMAND_dms_get_imei,
+	  .decode = dms_decode_imei, .type = STATUS_ALL_IDENTITY },
+	{ .name = "iccid", .cmd = __UQMI_COMMAND_dms_get_iccid,
+	  .decode = dms_decode_iccid, .type = STATUS_ALL_IDENTITY },
+	{ .name = "capabilities", .cmd = __UQMI_COMMAND_dms_get_capabilities,
+	  .decode = dms_decode_capabilities, .type = STATUS_ALL_IDENTITY },
+};
+
+static void
+status_all_add_error(struct uqmi_status_all_req *sreq, const char *msg)
+{
+	void *c;
+
+	c = blobmsg_open_table(&status, sreq->name);
+	blobmsg_add_string(&status, "error", msg);
+	blobmsg_close_table(&status, c);
+}
+
+/*
+ * Decode the response into a separate buffer and move its (first) result
+ * into the combined table under the name of the query.
+ */
+static void
+status_all_result_cb(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg)
+{
+	struct uqmi_status_all_req *sreq = container_of(req, struct uqmi_status_all_req, req);
+	struct blob_buf result = {};
+	struct blob_attr *attr;
+
+	if (!msg) {
+		status_all_add_error(sreq, qmi_get_error_str(req->ret));
+		return;
+	}
+
+	blob_buf_init(&result, 0);
+	sreq->decode(&result, msg);
+	if (blob_len(result.head)) {
+		attr = blob_data(result.head);
+		blobmsg_add_field(&status, blobmsg_type(attr), sreq->name,
+				  blobmsg_data(attr), blobmsg_data_len(attr));
+	}
+	blob_buf_free(&result);
+}
+
+static void
+status_all_query(struct qmi_dev *qmi, struct qmi_msg *msg, int types)
+{
+	const struct uqmi_cmd_handler *handler;
+	struct uqmi_status_all_req *sreq;
+	enum qmi_cmd_result res;
+	int i;
+
+	/* send all queries first, then collect the responses */
+	for (i = 0; i < ARRAY_SIZE(status_all_reqs); i++) {
+		sreq = &status_all_reqs[i];
+		handler = &uqmi_cmd_handler[sreq->cmd];
+		sreq->started = false;
+
+		if (!(sreq->type & types))
+			continue;
+
+		if (qmi_service_connect(qmi, handler->type, -1)) {
+			status_all_add_error(sreq, "Failed to connect to service");
+			continue;
+		}
+
+		res = handler->prepare(qmi, &sreq->req, msg, NULL);
+		if (res != QMI_CMD_REQUEST)
+			continue;
+
+		qmi_request_start(qmi, &sreq->req, status_all_result_cb);
+		sreq->started = true;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(status_all_reqs); i++) {
+		if (status_all_reqs[i].started)
+			qmi_request_wait(qmi, &status_all_reqs[i].req);
+	}
+}
+
+#define cmd_status_all_cb no_cb
+static enum qmi_cmd_result
+cmd_status_all_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	void *c;
+
+	c = blobmsg_open_table(&status, NULL);
+	status_all_query(qmi, msg, STATUS_ALL_STATE | STATUS_ALL_IDENTITY);
+	blobmsg_close_table(&status, c);
+	return QMI_CMD_DONE;
+}
+
+/*
+ * Write the composite status in the Prometheus text format, e.g. for the
+ * node_exporter textfile collector. The file is replaced atomically so that
+ * the collector never sees a partial update.
+ */
+#define cmd_prometheus_textfile_cb no_cb
+static enum qmi_cmd_result
+cmd_prometheus_textfile_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	char tmp[PATH_MAX];
+	FILE *f;
+	void *c;
+
+	c = blobmsg_open_table(&status, NULL);
+	status_all_query(qmi, msg, STATUS_ALL_STATE | STATUS_ALL_IDENTITY | STATUS_ALL_COUNTERS);
+	blobmsg_close_table(&status, c);
+
+	if (!strcmp(arg, "-")) {
+		uqmi_output_prometheus(stdout, blob_data(status.head));
+		blob_buf_init(&status, 0);
+		return QMI_CMD_DONE;
+	}
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", arg);
+	f = fopen(tmp, "w");
+	if (f) {
+		uqmi_output_prometheus(f, blob_data(status.head));
+		if (fclose(f) || rename(tmp, arg)) {
+			unlink(tmp);
+			f = NULL;
+		}
+	}
+
+	blob_buf_init(&status, 0);
+	if (!f)
+		return uqmi_add_error("Failed to write metrics file");
+
+	return QMI_CMD_DONE;
+}
+
+static int publish_interval = 5000;
+
+#define cmd_publish_interval_cb no_cb
+static enum qmi_cmd_result
+cmd_publish_interval_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	char *err;
+	long val = strtol(arg, &err, 10);
+
+	if (!*arg || *err || val <= 0 || val > INT_MAX)
+		return uqmi_add_error("Invalid interval");
+
+	publish_interval = val;
+
+	return QMI_CMD_DONE;
+}
+
+/*
+ * Keep the NAS, WDS and UIM state in a shared status segment up to date, so
+ * that any number of readers can get it with --read-status without talking
+ * to the modem. Identity data does not change and is left out. With
+ * --kpi-file, every update is also recorded as a sample in the KPI ring.
+ */
+#define cmd_publish_status_cb no_cb
+static enum qmi_cmd_result
+cmd_publish_status_prepare(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg, char *arg)
+{
+	bool complete = false;
+	char *str;
+	void *c;
+	int ret;
+
+	ret = uqmi_shm_create(arg);
+	if (ret) {
+		blobmsg_printf(&status, NULL, "Failed to create %s: %s", arg, strerror(-ret));
+		return QMI_CMD_EXIT;
+	}
+
+	do {
+		blob_buf_init(&status, 0);
+		c = blobmsg_open_table(&status, NULL);
+		blobmsg_add_u64(&status, "updated", time(NULL));
+		status_all_query(qmi, msg, STATUS_ALL_STATE | STATUS_ALL_COUNTERS);
+		blobmsg_close_table(&status, c);
+		uqmi_kpi_add(blob_data(status.head));
+
+		str = blobmsg_format_json(blob_data(status.head), false);
+		if (str) {
+			if (uqmi_shm_update(str, strlen(str)))
+				fprintf(stderr, "Status does not fit into the segment\n");
+			free(str);
+		}
+	} while (qmi_device_wait(qmi, &complete, publish_interval) == QMI_ERROR_TIMEOUT);
+
+	uqmi_shm_close();
+	blob_buf_init(&status, 0);
+	return QMI_CMD_DONE;
+}
+
 #define __uqmi_command(_name, _optname, _arg, _type) \
 	[__UQMI_COMMAND_##_name] = { \
 		.name = #_optname, \
@@ -198,17 +432,84 @@ void uqmi_add_command(char *arg, int cmd)
 
 static void uqmi_print_result(struct blob_attr *data)
 {
-	char *str;
-
 	if (!blob_len(data))
 		return;
 
-	str = blobmsg_format_json_indent(blob_data(data), false, single_line ? -1 : 0);
-	if (!str)
+	switch (output_format) {
+	case UQMI_OUTPUT_SHELL:
+		uqmi_output_shell(stdout, blob_data(data), result_name);
+		break;
+	case UQMI_OUTPUT_BLOB:
+		uqmi_output_blob(stdout, blob_data(data));
+		break;
+	default:
+		uqmi_output_json(stdout, blob_data(data), single_line ? -1 : 0);
+		break;
+	}
+}
+
+/* print the current result right away, for commands producing a stream */
+static void uqmi_flush_result(void)
+{
+	uqmi_print_result(status.head);
+	fflush(stdout);
+	blob_buf_init(&status, 0);
+}
+
+/* print the current result as one line of JSON, for JSON Lines streams */
+static void uqmi_flush_json_line(void)
+{
+	if (blob_len(status.head))
+		uqmi_output_json(stdout, blob_data(status.head), -1);
+	fflush(stdout);
+	blob_buf_init(&status, 0);
+}
+
+static const int uqmi_cached_cmds[] = {
+	__UQMI_COMMAND_version,
+	__UQMI_COMMAND_dms_get_capabilities,
+	__UQMI_COMMAND_dms_get_iccid,
+	__UQMI_COMMAND_dms_get_imei,
+	__UQMI_COMMAND_dms_get_model,
+	__UQMI_COMMAND_dms_get_revision,
+};
+
+static bool uqmi_cmd_cacheable(const struct uqmi_cmd_handler *handler)
+{
+	int i;
+
+	if (!uqmi_cache_enabled())
+		return false;
+
+	for (i = 0; i < ARRAY_SIZE(uqmi_cached_cmds); i++)
+		if (handler == &uqmi_cmd_handler[uqmi_cached_cmds[i]])
+			return true;
+
+	return false;
+}
+
+static bool uqmi_cache_lookup(const struct uqmi_cmd_handler *handler)
+{
+	struct blob_attr *data;
+
+	if (!uqmi_cmd_cacheable(handler))
+		return false;
+
+	data = uqmi_cache_get(handler->name);
+	if (!data)
+		return false;
+
+	blobmsg_add_field(&status, blobmsg_type(data), NULL,
+			  blobmsg_data(data), blobmsg_data_len(data));
+	return true;
+}
+
+static void uqmi_cache_store(const struct uqmi_cmd_handler *handler)
+{
+	if (!uqmi_cmd_cacheable(handler) || !blob_len(status.head))
 		return;
 
-	printf("%s\n", str);
-	free(str);
+	uqmi_cache_set(handler->name, blob_data(status.head));
 }
 
 static bool __uqmi_run_commands(struct qmi_dev *qmi, bool option)
@@ -225,8 +526,11 @@ static bool __uqmi_run_commands(struct qmi_dev *qmi, bool option)
 		if (cmd_option != option)
 			continue;
 
+		result_name = cmds[i].handler->name;
 		blob_buf_init(&status, 0);
-		if (cmds[i].handler->type > QMI_SERVICE_CTL &&
+		if (!option && uqmi_cache_lookup(cmds[i].handler)) {
+			res = QMI_CMD_DONE;
+		} else if (cmds[i].handler->type > QMI_SERVICE_CTL &&
 		    qmi_service_connect(qmi, cmds[i].handler->type, -1)) {
 			uqmi_add_error("Failed to connect to service");
 			res = QMI_CMD_EXIT;
@@ -240,11 +544,16 @@ static bool __uqmi_run_commands(struct qmi_dev *qmi, bool option)
 			if (qmi_request_wait(qmi, &req)) {
 				uqmi_add_error(qmi_get_error_str(req.ret));
 				do_break = true;
+			} else {
+				uqmi_cache_store(cmds[i].handler);
 			}
 		} else if (res == QMI_CMD_EXIT) {
 			do_break = true;
 		}
 
+		if (do_break)
+			result_name = "error";
+
 		uqmi_print_result(status.head);
 		if (do_break)
 			return false;
@@ -252,6 +561,38 @@ static bool __uqmi_run_commands(struct qmi_dev *qmi, bool option)
 	return true;
 }
 
+/* convert a stream written with --format blob back into the selected format */
+int uqmi_decode_blob(const char *path)
+{
+	struct blob_attr *attr;
+	FILE *f = stdin;
+	int ret;
+
+	if (strcmp(path, "-") != 0)
+		f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		return -1;
+	}
+
+	result_name = "value";
+	while ((ret = uqmi_blob_read(f, &attr)) > 0) {
+		if (output_format == UQMI_OUTPUT_SHELL)
+			uqmi_output_shell(stdout, attr, result_name);
+		else
+			uqmi_output_json(stdout, attr, single_line ? -1 : 0);
+		free(attr);
+	}
+
+	if (ret < 0)
+		fprintf(stderr, "Truncated or invalid record in %s\n", path);
+
+	if (f != stdin)
+		fclose(f);
+
+	return ret;
+}
+
 int uqmi_add_error(const char *msg)
 {
 	blobmsg_add_string(&status, NULL, msg);
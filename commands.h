@@ -60,6 +60,10 @@ struct uqmi_cmd {
 	__uqmi_command(set_client_id, set-client-id, required, CMD_TYPE_OPTION), \
 	__uqmi_command(get_client_id, get-client-id, required, QMI_SERVICE_CTL), \
 	__uqmi_command(ctl_set_data_format, set-data-format, required, QMI_SERVICE_CTL), \
+	__uqmi_command(status_all, status-all, no, QMI_SERVICE_CTL), \
+	__uqmi_command(prometheus_textfile, prometheus-textfile, required, QMI_SERVICE_CTL), \
+	__uqmi_command(publish_status, publish-status, required, QMI_SERVICE_CTL), \
+	__uqmi_command(publish_interval, publish-interval, required, CMD_TYPE_OPTION), \
 	__uqmi_wds_commands, \
 	__uqmi_dms_commands, \
 	__uqmi_nas_commands, \
@@ -79,5 +83,6 @@ extern const struct uqmi_cmd_handler uqmi_cmd_handler[];
 void uqmi_add_command(char *arg, int longidx);
 bool uqmi_run_commands(struct qmi_dev *qmi);
 int uqmi_add_error(const char *msg);
+int uqmi_decode_blob(const char *path);
 
 #endif
@@ -78,9 +78,14 @@ sub gen_foreach_message_type($$$)
 		my $args = [];
 		my $fields = [];
 
-		next if $entry->{type} ne 'Message';
+		next if $entry->{type} ne 'Message' and $entry->{type} ne 'Indication';
 		next if not defined $entry->{input} and not defined $entry->{output};
 
+		if ($entry->{type} eq 'Indication') {
+			&$res_sub($prefix.$entry->{name}." Indication", $entry->{output}, $entry);
+			next;
+		}
+
 		&$req_sub($prefix.$entry->{name}." Request", $entry->{input}, $entry);
 		&$res_sub($prefix.$entry->{name}." Response", $entry->{output}, $entry);
 	}
@@ -112,5 +112,16 @@ sub gen_parse_func_header($$)
 	$func and print "$func;\n\n";
 }
 
+sub gen_indication_id($$$)
+{
+	my $name = shift;
+	my $data = shift;
+	my $entry = shift;
+
+	$entry->{type} eq 'Indication' or return;
+	print "#define QMI_".uc(gen_cname($name))." $entry->{id}\n\n";
+}
+
+gen_foreach_message_type($data, sub {}, \&gen_indication_id);
 gen_foreach_message_type($data, \&gen_tlv_struct, \&gen_tlv_struct);
 gen_foreach_message_type($data, \&gen_set_func_header, \&gen_parse_func_header);
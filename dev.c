@@ -91,11 +91,55 @@ static void __qmi_request_complete(struct qmi_dev *qmi, struct qmi_request *req,
 	}
 }
 
+static struct qmi_client *
+qmi_client_find(struct qmi_dev *qmi, uint8_t service, uint8_t client_id)
+{
+	struct qmi_client *cl;
+
+	list_for_each_entry(cl, &qmi->clients, list)
+		if (cl->service == service && cl->client_id == client_id)
+			return cl;
+
+	return NULL;
+}
+
+static void qmi_process_indication(struct qmi_dev *qmi, struct qmi_msg *msg)
+{
+	struct qmi_indication *ind, *tmp;
+	uint16_t message = le16_to_cpu(msg->svc.message);
+	int idx = qmi_get_service_idx(msg->qmux.service);
+
+	if (idx < 0 || !(qmi->service_connected & (1 << idx)))
+		return;
+
+	/* 0xff is the broadcast client id */
+	if (msg->qmux.client != 0xff &&
+	    msg->qmux.client != qmi->service_data[idx].client_id &&
+	    !qmi_client_find(qmi, msg->qmux.service, msg->qmux.client))
+		return;
+
+	list_for_each_entry_safe(ind, tmp, &qmi->ind, list) {
+		if (ind->service != msg->qmux.service)
+			continue;
+
+		if (ind->message != message)
+			continue;
+
+		ind->cb(qmi, ind, msg);
+	}
+}
+
 static void qmi_process_msg(struct qmi_dev *qmi, struct qmi_msg *msg)
 {
 	struct qmi_request *req;
 	uint16_t tid;
 
+	if (msg->qmux.service != QMI_SERVICE_CTL &&
+	    msg->flags == QMI_SERVICE_FLAG_INDICATION) {
+		qmi_process_indication(qmi, msg);
+		return;
+	}
+
 	if (msg->flags != QMI_CTL_FLAG_RESPONSE && msg->flags != QMI_SERVICE_FLAG_RESPONSE)
 		return;
 
@@ -111,6 +155,10 @@ static void qmi_process_msg(struct qmi_dev *qmi, struct qmi_msg *msg)
 		if (req->tid != tid)
 			continue;
 
+		if (req->service != QMI_SERVICE_CTL &&
+		    req->client_id != msg->qmux.client)
+			continue;
+
 		__qmi_request_complete(qmi, req, msg);
 		return;
 	}
@@ -157,30 +205,25 @@ static void qmi_notify_read(struct ustream *us, int bytes)
 	}
 }
 
-int qmi_request_start(struct qmi_dev *qmi, struct qmi_request *req, request_cb cb)
+static int
+__qmi_request_start(struct qmi_dev *qmi, struct qmi_request *req, request_cb cb,
+		    uint8_t client_id, uint16_t tid)
 {
 	struct qmi_msg *msg = qmi->buf;
 	int len = qmi_complete_request_message(msg);
-	uint16_t tid;
 	void *buf = (void *) qmi->buf;
 
 	memset(req, 0, sizeof(*req));
 	req->ret = -1;
 	req->service = msg->qmux.service;
 	if (req->service == QMI_SERVICE_CTL) {
-		tid = qmi->ctl_tid++;
 		msg->ctl.transaction = tid;
 	} else {
-		int idx = qmi_get_service_idx(req->service);
-
-		if (idx < 0)
-			return -1;
-
-		tid = qmi->service_data[idx].tid++;
 		msg->svc.transaction = cpu_to_le16(tid);
-		msg->qmux.client = qmi->service_data[idx].client_id;
+		msg->qmux.client = client_id;
 	}
 
+	req->client_id = client_id;
 	req->tid = tid;
 	req->cb = cb;
 	req->pending = true;
@@ -197,6 +240,33 @@ int qmi_request_start(struct qmi_dev *qmi, struct qmi_request *req, request_cb c
 	return 0;
 }
 
+int qmi_request_start(struct qmi_dev *qmi, struct qmi_request *req, request_cb cb)
+{
+	struct qmi_msg *msg = qmi->buf;
+	int idx;
+
+	if (msg->qmux.service == QMI_SERVICE_CTL)
+		return __qmi_request_start(qmi, req, cb, 0, qmi->ctl_tid++);
+
+	idx = qmi_get_service_idx(msg->qmux.service);
+	if (idx < 0)
+		return -1;
+
+	return __qmi_request_start(qmi, req, cb, qmi->service_data[idx].client_id,
+				   qmi->service_data[idx].tid++);
+}
+
+int qmi_client_request_start(struct qmi_dev *qmi, struct qmi_client *cl,
+			     struct qmi_request *req, request_cb cb)
+{
+	struct qmi_msg *msg = qmi->buf;
+
+	if (msg->qmux.service != cl->service)
+		return -1;
+
+	return __qmi_request_start(qmi, req, cb, cl->client_id, cl->tid++);
+}
+
 void qmi_request_cancel(struct qmi_dev *qmi, struct qmi_request *req)
 {
 	req->cb = NULL;
@@ -232,6 +302,66 @@ int qmi_request_wait(struct qmi_dev *qmi, struct qmi_request *req)
 	return req->ret;
 }
 
+void qmi_indication_register(struct qmi_dev *qmi, struct qmi_indication *ind,
+			     QmiService svc, uint16_t message, indication_cb cb)
+{
+	ind->service = svc;
+	ind->message = message;
+	ind->cb = cb;
+	list_add_tail(&ind->list, &qmi->ind);
+}
+
+void qmi_indication_unregister(struct qmi_dev *qmi, struct qmi_indication *ind)
+{
+	list_del(&ind->list);
+}
+
+struct qmi_wait {
+	struct uloop_timeout timeout;
+	bool expired;
+};
+
+static void qmi_wait_timeout_cb(struct uloop_timeout *timeout)
+{
+	struct qmi_wait *w = container_of(timeout, struct qmi_wait, timeout);
+
+	w->expired = true;
+	uloop_cancelled = true;
+}
+
+int qmi_device_wait(struct qmi_dev *qmi, bool *complete, int timeout)
+{
+	struct qmi_wait w = {
+		.timeout.cb = qmi_wait_timeout_cb,
+	};
+	bool cancelled;
+	int ret = 0;
+
+	if (timeout >= 0)
+		uloop_timeout_set(&w.timeout, timeout);
+
+	while (!*complete) {
+		if (cancel_all_requests) {
+			ret = QMI_ERROR_CANCELLED;
+			break;
+		}
+
+		if (w.expired) {
+			ret = QMI_ERROR_TIMEOUT;
+			break;
+		}
+
+		cancelled = uloop_cancelled;
+		uloop_cancelled = false;
+		uloop_run();
+		uloop_cancelled = cancelled;
+	}
+
+	uloop_timeout_cancel(&w.timeout);
+
+	return ret;
+}
+
 struct qmi_connect_request {
 	struct qmi_request req;
 	int cid;
@@ -249,15 +379,45 @@ static void qmi_connect_service_cb(struct qmi_dev *qmi, struct qmi_request *req,
 	creq->cid = res.data.allocation_info.cid;
 }
 
-int qmi_service_connect(struct qmi_dev *qmi, QmiService svc, int client_id)
+static int qmi_allocate_cid(struct qmi_dev *qmi, QmiService svc, int *client_id)
 {
 	struct qmi_ctl_allocate_cid_request creq = {
 		QMI_INIT(service, svc)
 	};
 	struct qmi_connect_request req;
-	int idx = qmi_get_service_idx(svc);
 	struct qmi_msg *msg = qmi->buf;
 
+	qmi_set_ctl_allocate_cid_request(msg, &creq);
+	qmi_request_start(qmi, &req.req, qmi_connect_service_cb);
+	qmi_request_wait(qmi, &req.req);
+
+	if (req.req.ret)
+		return req.req.ret;
+
+	*client_id = req.cid;
+	return 0;
+}
+
+static void qmi_release_cid(struct qmi_dev *qmi, QmiService svc, int client_id)
+{
+	struct qmi_ctl_release_cid_request creq = {
+		QMI_INIT_SEQUENCE(release_info,
+			.service = svc,
+			.cid = client_id,
+		)
+	};
+	struct qmi_request req;
+	struct qmi_msg *msg = qmi->buf;
+
+	qmi_set_ctl_release_cid_request(msg, &creq);
+	qmi_request_start(qmi, &req, NULL);
+	qmi_request_wait(qmi, &req);
+}
+
+int qmi_service_connect(struct qmi_dev *qmi, QmiService svc, int client_id)
+{
+	int idx = qmi_get_service_idx(svc);
+
 	if (idx < 0)
 		return -1;
 
@@ -265,14 +425,10 @@ int qmi_service_connect(struct qmi_dev *qmi, QmiService svc, int client_id)
 		return 0;
 
 	if (client_id < 0) {
-		qmi_set_ctl_allocate_cid_request(msg, &creq);
-		qmi_request_start(qmi, &req.req, qmi_connect_service_cb);
-		qmi_request_wait(qmi, &req.req);
+		int ret = qmi_allocate_cid(qmi, svc, &client_id);
 
-		if (req.req.ret)
-			return req.req.ret;
-
-		client_id = req.cid;
+		if (ret)
+			return ret;
 	} else {
 		qmi->service_keep_cid |= (1 << idx);
 	}
@@ -288,22 +444,12 @@ int qmi_service_connect(struct qmi_dev *qmi, QmiService svc, int client_id)
 static void __qmi_service_disconnect(struct qmi_dev *qmi, int idx)
 {
 	int client_id = qmi->service_data[idx].client_id;
-	struct qmi_ctl_release_cid_request creq = {
-		QMI_INIT_SEQUENCE(release_info,
-			.service = qmi_services[idx],
-			.cid = client_id,
-		)
-	};
-	struct qmi_request req;
-	struct qmi_msg *msg = qmi->buf;
 
 	qmi->service_connected &= ~(1 << idx);
 	qmi->service_data[idx].client_id = -1;
 	qmi->service_data[idx].tid = 0;
 
-	qmi_set_ctl_release_cid_request(msg, &creq);
-	qmi_request_start(qmi, &req, NULL);
-	qmi_request_wait(qmi, &req);
+	qmi_release_cid(qmi, qmi_services[idx], client_id);
 }
 
 int qmi_service_release_client_id(struct qmi_dev *qmi, QmiService svc)
@@ -313,11 +459,44 @@ int qmi_service_release_client_id(struct qmi_dev *qmi, QmiService svc)
 	return 0;
 }
 
+int qmi_client_open(struct qmi_dev *qmi, struct qmi_client *cl, QmiService svc, int client_id)
+{
+	int ret;
+
+	if (qmi_get_service_idx(svc) < 0)
+		return -1;
+
+	if (client_id < 0) {
+		ret = qmi_allocate_cid(qmi, svc, &client_id);
+		if (ret)
+			return ret;
+	}
+
+	memset(cl, 0, sizeof(*cl));
+	cl->service = svc;
+	cl->client_id = client_id;
+	cl->tid = 1;
+	list_add_tail(&cl->list, &qmi->clients);
+
+	return 0;
+}
+
+void qmi_client_close(struct qmi_dev *qmi, struct qmi_client *cl)
+{
+	list_del(&cl->list);
+
+	if (!cl->keep)
+		qmi_release_cid(qmi, cl->service, cl->client_id);
+}
+
 static void qmi_close_all_services(struct qmi_dev *qmi)
 {
 	uint32_t connected = qmi->service_connected;
 	int idx;
 
+	while (!list_empty(&qmi->clients))
+		qmi_client_close(qmi, list_first_entry(&qmi->clients, struct qmi_client, list));
+
 	qmi->service_keep_cid &= ~qmi->service_release_cid;
 	for (idx = 0; connected; idx++, connected >>= 1) {
 		if (!(connected & 1))
@@ -330,6 +509,16 @@ static void qmi_close_all_services(struct qmi_dev *qmi)
 	}
 }
 
+bool qmi_service_keep_client_id(struct qmi_dev *qmi, QmiService svc)
+{
+	int idx = qmi_get_service_idx(svc);
+
+	if (idx < 0)
+		return false;
+
+	return (qmi->service_keep_cid & ~qmi->service_release_cid) & (1 << idx);
+}
+
 int qmi_service_get_client_id(struct qmi_dev *qmi, QmiService svc)
 {
 	int idx = qmi_get_service_idx(svc);
@@ -362,6 +551,8 @@ int qmi_device_open(struct qmi_dev *qmi, const char *path)
 	us->notify_read = qmi_notify_read;
 	ustream_fd_init(&qmi->sf, fd);
 	INIT_LIST_HEAD(&qmi->req);
+	INIT_LIST_HEAD(&qmi->ind);
+	INIT_LIST_HEAD(&qmi->clients);
 	qmi->ctl_tid = 1;
 	qmi->buf = msgbuf.u.buf;
 
@@ -410,6 +601,17 @@ const char *qmi_get_error_str(int code)
 {
 	int i;
 
+	switch (code) {
+	case QMI_ERROR_NO_DATA:
+		return "No data";
+	case QMI_ERROR_INVALID_DATA:
+		return "Invalid data";
+	case QMI_ERROR_CANCELLED:
+		return "Cancelled";
+	case QMI_ERROR_TIMEOUT:
+		return "Timed out";
+	}
+
 	for (i = 0; i < ARRAY_SIZE(qmi_errors); i++) {
 		if (qmi_errors[i].code == code)
 			return qmi_errors[i].text;
@@ -0,0 +1,178 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Checks and times the GSM 7 bit codec against a septet by septet reference
+ * implementation. Built with -DBUILD_GSM7_BENCH=ON, not installed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* for the alphabet tables */
+#include "gsm7.c"
+
+#define BENCH_SEPTETS	160
+#define BENCH_ROUNDS	200000
+
+static uint32_t bench_seed = 1;
+
+static uint8_t bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return bench_seed >> 16;
+}
+
+static void ref_pack(unsigned char *data, const uint8_t *septets, int n, int shift)
+{
+	int i, bit, pos;
+
+	for (i = 0; i < n; i++) {
+		for (bit = 0; bit < 7; bit++) {
+			if (!(septets[i] & (1 << bit)))
+				continue;
+
+			pos = shift + 7 * i + bit;
+			data[pos / 8] |= 1 << (pos % 8);
+		}
+	}
+}
+
+static int ref_decode(char *dest, const unsigned char *data, int n, int shift)
+{
+	bool escape = false;
+	int len = 0, i, pos;
+	uint8_t c;
+
+	for (i = 0; i < n; i++) {
+		pos = shift + 7 * i;
+		c = data[pos / 8] >> (pos % 8);
+		if (pos % 8 > 1)
+			c |= data[pos / 8 + 1] << (8 - pos % 8);
+		c &= 0x7f;
+
+		if (escape) {
+			escape = false;
+			if (gsm7_ext[c]) {
+				len += gsm7_put_utf8(dest + len, gsm7_ext[c]);
+				continue;
+			}
+		} else if (c == 0x1b) {
+			escape = true;
+			continue;
+		}
+
+		len += gsm7_put_utf8(dest + len, gsm7_default[c]);
+	}
+
+	dest[len] = 0;
+	return len;
+}
+
+static int check_roundtrip(void)
+{
+	uint8_t septets[BENCH_SEPTETS], out[BENCH_SEPTETS];
+	unsigned char data[BENCH_SEPTETS + 2], ref[BENCH_SEPTETS + 2];
+	char text[BENCH_SEPTETS * 3 + 1], ref_text[BENCH_SEPTETS * 3 + 1];
+	int shift, n, i, round;
+
+	for (round = 0; round < 100; round++) {
+		for (shift = 0; shift < 8; shift++) {
+			for (n = 0; n <= BENCH_SEPTETS; n++) {
+				for (i = 0; i < n; i++)
+					septets[i] = bench_rand() & 0x7f;
+
+				memset(data, 0, sizeof(data));
+				memset(ref, 0, sizeof(ref));
+				gsm7_pack(data, septets, n, shift);
+				ref_pack(ref, septets, n, shift);
+				if (memcmp(data, ref, sizeof(data)) != 0) {
+					fprintf(stderr, "pack mismatch: shift=%d n=%d\n", shift, n);
+					return 1;
+				}
+
+				gsm7_unpack(out, data, n, shift);
+				if (memcmp(out, septets, n) != 0) {
+					fprintf(stderr, "unpack mismatch: shift=%d n=%d\n", shift, n);
+					return 1;
+				}
+
+				gsm7_decode(text, data, n, shift);
+				ref_decode(ref_text, data, n, shift);
+				if (strcmp(text, ref_text) != 0) {
+					fprintf(stderr, "decode mismatch: shift=%d n=%d\n", shift, n);
+					return 1;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+static double bench_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_decode(int (*decode)(char *, const unsigned char *, int, int),
+			   const unsigned char *data, char *text)
+{
+	double start = bench_time();
+	int i, len = 0;
+
+	for (i = 0; i < BENCH_ROUNDS; i++)
+		len += decode(text, data, BENCH_SEPTETS, 0);
+
+	/* keep the calls from being optimized out */
+	if (len < 0)
+		fputs(text, stderr);
+
+	return (bench_time() - start) * 1e9 / BENCH_ROUNDS;
+}
+
+int main(void)
+{
+	uint8_t septets[BENCH_SEPTETS];
+	unsigned char data[BENCH_SEPTETS + 2] = {};
+	char text[BENCH_SEPTETS * 3 + 1];
+	double t, t_ref;
+	int i;
+
+	if (check_roundtrip())
+		return 1;
+
+	printf("pack/unpack/decode match the reference for shift 0-7\n");
+
+	for (i = 0; i < BENCH_SEPTETS; i++)
+		septets[i] = bench_rand() & 0x7f;
+	gsm7_pack(data, septets, BENCH_SEPTETS, 0);
+
+	t_ref = bench_decode(ref_decode, data, text);
+	t = bench_decode(gsm7_decode, data, text);
+	printf("decode %d septets: reference %.0f ns, gsm7_decode %.0f ns (%.2fx)\n",
+	       BENCH_SEPTETS, t_ref, t, t_ref / t);
+
+	return 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gsm7.h"
+
+/* GSM 03.38 default alphabet, a doubled escape code shows as a no-break space */
+static const uint16_t gsm7_default[128] = {
+	0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+	0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+	0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+	0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+	0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+	0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+};
+
+/* extension table, 0 where the default table applies */
+static const uint16_t gsm7_ext[128] = {
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x000C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x005E, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x007B, 0x007D, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x005C,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x005B, 0x007E, 0x005D, 0x0000,
+	0x007C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x20AC, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+};
+
+/* Latin-1 to GSM 7 bit, 0x80 | septet for the extension table, 0xff if none */
+static const uint8_t gsm7_latin1[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0x0A, 0xFF, 0x8A, 0x0D, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x20, 0x21, 0x22, 0x23, 0x02, 0x25, 0x26, 0x27,
+	0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+	0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+	0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+	0x00, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+	0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+	0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57,
+	0x58, 0x59, 0x5A, 0xBC, 0xAF, 0xBE, 0x94, 0x11,
+	0xFF, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+	0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+	0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+	0x78, 0x79, 0x7A, 0xA8, 0xC0, 0xA9, 0xBD, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x40, 0xFF, 0x01, 0x24, 0x03, 0xFF, 0x5F,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x60,
+	0xFF, 0xFF, 0xFF, 0xFF, 0x5B, 0x0E, 0x1C, 0x09,
+	0xFF, 0x1F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x5D, 0xFF, 0xFF, 0xFF, 0xFF, 0x5C, 0xFF,
+	0x0B, 0xFF, 0xFF, 0xFF, 0x5E, 0xFF, 0xFF, 0x1E,
+	0x7F, 0xFF, 0xFF, 0xFF, 0x7B, 0x0F, 0x1D, 0x09,
+	0x04, 0x05, 0xFF, 0xFF, 0x07, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x7D, 0x08, 0xFF, 0xFF, 0xFF, 0x7C, 0xFF,
+	0x0C, 0x06, 0xFF, 0xFF, 0x7E, 0xFF, 0xFF, 0xFF,
+};
+
+/* Greek capital letters U+0393 to U+03A9 */
+static const uint8_t gsm7_greek[] = {
+	0x13, 0x10, 0xFF, 0xFF, 0xFF, 0x19, 0xFF, 0xFF,
+	0x14, 0xFF, 0xFF, 0x1A, 0xFF, 0x16, 0xFF, 0xFF,
+	0x18, 0xFF, 0xFF, 0x12, 0xFF, 0x17, 0x15,
+};
+
+static int
+gsm7_put_utf8(char *dest, uint16_t c)
+{
+	if (c < 0x80) {
+		*dest = c;
+		return 1;
+	} else if (c < 0x800) {
+		*(dest++) = 0xc0 | ((c >> 6) & 0x1f);
+		*dest = 0x80 | (c & 0x3f);
+		return 2;
+	} else {
+		*(dest++) = 0xe0 | ((c >> 12) & 0xf);
+		*(dest++) = 0x80 | ((c >> 6) & 0x3f);
+		*dest = 0x80 | (c & 0x3f);
+		return 3;
+	}
+}
+
+static inline uint64_t
+gsm7_load(const unsigned char *data, int len)
+{
+	uint64_t val = 0;
+
+	while (len--)
+		val = (val << 8) | data[len];
+
+	return val;
+}
+
+/*
+ * Unpack n septets, the first one starting shift bits into data. Every 7
+ * byte block holds 8 septets and is handled as one word, only the tail is
+ * unpacked septet by septet.
+ */
+void gsm7_unpack(uint8_t *septets, const unsigned char *data, int n, int shift)
+{
+	uint64_t val;
+	int i = 0, j, bit;
+
+	for (; n - i >= 8; i += 8, data += 7) {
+		val = gsm7_load(data, shift ? 8 : 7) >> shift;
+		for (j = 0; j < 8; j++, val >>= 7)
+			septets[i + j] = val & 0x7f;
+	}
+
+	for (bit = shift; i < n; i++, bit += 7) {
+		unsigned int word = data[bit / 8];
+
+		if (bit % 8 > 1)
+			word |= data[bit / 8 + 1] << 8;
+		septets[i] = (word >> (bit % 8)) & 0x7f;
+	}
+}
+
+/* counterpart of gsm7_unpack, the destination bits must be zero */
+void gsm7_pack(unsigned char *data, const uint8_t *septets, int n, int shift)
+{
+	uint64_t val;
+	int i = 0, j, bit;
+
+	for (; n - i >= 8; i += 8, data += 7) {
+		val = 0;
+		for (j = 7; j >= 0; j--)
+			val = (val << 7) | (septets[i + j] & 0x7f);
+
+		val <<= shift;
+		for (j = 0; j < (shift ? 8 : 7); j++)
+			data[j] |= val >> (8 * j);
+	}
+
+	for (bit = shift; i < n; i++, bit += 7) {
+		data[bit / 8] |= septets[i] << (bit % 8);
+		if (bit % 8 > 1)
+			data[bit / 8 + 1] |= septets[i] >> (8 - bit % 8);
+	}
+}
+
+/*
+ * Decode n packed septets to UTF-8. dest needs room for 3 * n + 1 bytes,
+ * returns the length of the string.
+ */
+int gsm7_decode(char *dest, const unsigned char *data, int n, int shift)
+{
+	bool escape = false;
+	uint8_t septets[8];
+	int len = 0, i, j, k;
+
+	for (i = 0; i < n; i += k) {
+		k = n - i < 8 ? n - i : 8;
+		gsm7_unpack(septets, data + 7 * (i / 8), k, shift);
+
+		for (j = 0; j < k; j++) {
+			uint8_t c = septets[j];
+
+			if (escape) {
+				escape = false;
+				if (gsm7_ext[c]) {
+					len += gsm7_put_utf8(dest + len, gsm7_ext[c]);
+					continue;
+				}
+			} else if (c == 0x1b) {
+				escape = true;
+				continue;
+			}
+
+			len += gsm7_put_utf8(dest + len, gsm7_default[c]);
+		}
+	}
+
+	dest[len] = 0;
+	return len;
+}
+
+/* septet for c, 0x1b00 | septet for the extension table, -1 if there is none */
+int gsm7_encode_char(uint16_t c)
+{
+	uint8_t val = 0xff;
+
+	if (c < 0x100)
+		val = gsm7_latin1[c];
+	else if (c >= 0x393 && c <= 0x3a9)
+		val = gsm7_greek[c - 0x393];
+	else if (c == 0x20ac)
+		return 0x1b00 | 0x65;
+
+	if (val == 0xff)
+		return -1;
+
+	if (val & 0x80)
+		return 0x1b00 | (val & 0x7f);
+
+	return val;
+}
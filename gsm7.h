@@ -0,0 +1,30 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __UQMI_GSM7_H
+#define __UQMI_GSM7_H
+
+#include <stdint.h>
+
+void gsm7_unpack(uint8_t *septets, const unsigned char *data, int n, int shift);
+void gsm7_pack(unsigned char *data, const uint8_t *septets, int n, int shift);
+int gsm7_decode(char *dest, const unsigned char *data, int n, int shift);
+int gsm7_encode_char(uint16_t c);
+
+#endif
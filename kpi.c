@@ -0,0 +1,351 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include <libubox/utils.h>
+#include <libubox/blobmsg.h>
+
+#include "shm.h"
+#include "kpi.h"
+#include "output.h"
+
+#define UQMI_KPI_READ_RETRIES	100
+#define UQMI_KPI_MAX_BUCKETS	1024
+
+static const char * const kpi_signal_names[] = {
+	[UQMI_KPI_RSSI] = "rssi",
+	[UQMI_KPI_RSRP] = "rsrp",
+	[UQMI_KPI_RSRQ] = "rsrq",
+	[UQMI_KPI_SNR] = "snr",
+};
+
+static const char * const kpi_counter_names[] = {
+	[UQMI_KPI_RX_BYTES] = "rx_bytes_ok",
+	[UQMI_KPI_TX_BYTES] = "tx_bytes_ok",
+};
+
+/* same strings as in the --get-serving-system and --get-signal-info output */
+static const char * const kpi_registration_states[] = {
+	"not_registered", "registered", "searching", "registering_denied", "unknown",
+};
+
+static const char * const kpi_radio_types[] = {
+	"cdma", "hdr", "gsm", "wcdma", "lte", "tdma",
+};
+
+static struct uqmi_kpi_ring *kpi;
+
+static uint8_t kpi_get_state(const char * const *names, int n, struct blob_attr *attr)
+{
+	int i;
+
+	if (!attr)
+		return UQMI_KPI_NO_STATE;
+
+	for (i = 0; i < n; i++)
+		if (!strcmp(names[i], blobmsg_get_string(attr)))
+			return i;
+
+	return UQMI_KPI_NO_STATE;
+}
+
+int uqmi_kpi_open(const char *path)
+{
+	kpi = uqmi_shm_map(path, sizeof(*kpi), true);
+	if (!kpi)
+		return -errno;
+
+	if (kpi->magic != UQMI_KPI_MAGIC || kpi->version != UQMI_KPI_VERSION) {
+		memset(kpi, 0, sizeof(*kpi));
+		kpi->version = UQMI_KPI_VERSION;
+		__atomic_store_n(&kpi->magic, UQMI_KPI_MAGIC, __ATOMIC_RELEASE);
+	} else if (kpi->seq & 1) {
+		kpi->seq++;
+	}
+
+	return 0;
+}
+
+bool uqmi_kpi_enabled(void)
+{
+	return !!kpi;
+}
+
+void uqmi_kpi_close(void)
+{
+	if (!kpi)
+		return;
+
+	munmap(kpi, sizeof(*kpi));
+	kpi = NULL;
+}
+
+/*
+ * Record one sample from a --status-all style table, which contains the
+ * signal-info, serving-system and packet-statistics results.
+ */
+void uqmi_kpi_add(struct blob_attr *data)
+{
+	enum {
+		SAMPLE_SIGNAL,
+		SAMPLE_SERVING,
+		SAMPLE_STATS,
+		__SAMPLE_MAX
+	};
+	static const struct blobmsg_policy sample_policy[__SAMPLE_MAX] = {
+		[SAMPLE_SIGNAL] = { "signal-info", BLOBMSG_TYPE_TABLE },
+		[SAMPLE_SERVING] = { "serving-system", BLOBMSG_TYPE_TABLE },
+		[SAMPLE_STATS] = { "packet-statistics", BLOBMSG_TYPE_TABLE },
+	};
+	static const struct blobmsg_policy signal_policy[] = {
+		[UQMI_KPI_RSSI] = { "rssi", BLOBMSG_TYPE_INT32 },
+		[UQMI_KPI_RSRP] = { "rsrp", BLOBMSG_TYPE_INT32 },
+		[UQMI_KPI_RSRQ] = { "rsrq", BLOBMSG_TYPE_INT32 },
+		[UQMI_KPI_SNR] = { "snr", BLOBMSG_TYPE_INT32 },
+		[__UQMI_KPI_SIGNAL_MAX] = { "signal", BLOBMSG_TYPE_INT32 },
+		[__UQMI_KPI_SIGNAL_MAX + 1] = { "type", BLOBMSG_TYPE_STRING },
+	};
+	static const struct blobmsg_policy counter_policy[__UQMI_KPI_COUNTER_MAX] = {
+		[UQMI_KPI_RX_BYTES] = { "rx_bytes_ok", BLOBMSG_TYPE_INT64 },
+		[UQMI_KPI_TX_BYTES] = { "tx_bytes_ok", BLOBMSG_TYPE_INT64 },
+	};
+	static const struct blobmsg_policy serving_policy = {
+		"registration", BLOBMSG_TYPE_STRING
+	};
+	struct blob_attr *tb[__SAMPLE_MAX];
+	struct blob_attr *sig[ARRAY_SIZE(signal_policy)];
+	struct blob_attr *cnt[__UQMI_KPI_COUNTER_MAX];
+	struct blob_attr *reg;
+	uint32_t seq, idx;
+	int i;
+
+	if (!kpi)
+		return;
+
+	blobmsg_parse(sample_policy, __SAMPLE_MAX, tb, blobmsg_data(data), blobmsg_data_len(data));
+	blobmsg_parse(signal_policy, ARRAY_SIZE(signal_policy), sig,
+		      tb[SAMPLE_SIGNAL] ? blobmsg_data(tb[SAMPLE_SIGNAL]) : NULL,
+		      tb[SAMPLE_SIGNAL] ? blobmsg_data_len(tb[SAMPLE_SIGNAL]) : 0);
+	blobmsg_parse(counter_policy, __UQMI_KPI_COUNTER_MAX, cnt,
+		      tb[SAMPLE_STATS] ? blobmsg_data(tb[SAMPLE_STATS]) : NULL,
+		      tb[SAMPLE_STATS] ? blobmsg_data_len(tb[SAMPLE_STATS]) : 0);
+	blobmsg_parse(&serving_policy, 1, &reg,
+		      tb[SAMPLE_SERVING] ? blobmsg_data(tb[SAMPLE_SERVING]) : NULL,
+		      tb[SAMPLE_SERVING] ? blobmsg_data_len(tb[SAMPLE_SERVING]) : 0);
+
+	/* GSM and TDMA only report a single signal level */
+	if (!sig[UQMI_KPI_RSSI])
+		sig[UQMI_KPI_RSSI] = sig[__UQMI_KPI_SIGNAL_MAX];
+
+	seq = uqmi_seq_write_begin(&kpi->seq);
+
+	idx = kpi->head % UQMI_KPI_SAMPLES;
+	kpi->time[idx] = time(NULL);
+	for (i = 0; i < __UQMI_KPI_SIGNAL_MAX; i++)
+		kpi->signal[i][idx] = sig[i] ? (int16_t) blobmsg_get_u32(sig[i]) : UQMI_KPI_NO_SIGNAL;
+	for (i = 0; i < __UQMI_KPI_COUNTER_MAX; i++)
+		kpi->counter[i][idx] = cnt[i] ? blobmsg_get_u64(cnt[i]) : UQMI_KPI_NO_COUNTER;
+	kpi->registration[idx] = kpi_get_state(kpi_registration_states,
+					       ARRAY_SIZE(kpi_registration_states), reg);
+	kpi->radio[idx] = kpi_get_state(kpi_radio_types, ARRAY_SIZE(kpi_radio_types),
+					sig[__UQMI_KPI_SIGNAL_MAX + 1]);
+	kpi->head++;
+
+	uqmi_seq_write_end(&kpi->seq, seq);
+}
+
+struct kpi_bucket {
+	struct {
+		int min, max, n;
+		int64_t sum;
+	} signal[__UQMI_KPI_SIGNAL_MAX];
+	uint64_t bytes[__UQMI_KPI_COUNTER_MAX];
+	int changes;
+	int samples;
+};
+
+static int kpi_read(const struct uqmi_kpi_ring *s, struct uqmi_kpi_ring *copy)
+{
+	uint32_t seq;
+	int i;
+
+	for (i = 0; i < UQMI_KPI_READ_RETRIES; i++) {
+		seq = uqmi_seq_read_begin(&s->seq);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		memcpy(copy, s, sizeof(*copy));
+		if (!uqmi_seq_read_retry(&s->seq, seq))
+			return 0;
+	}
+
+	return -EAGAIN;
+}
+
+static void kpi_add_sample(struct kpi_bucket *b, const struct uqmi_kpi_ring *r,
+			   uint32_t idx, uint32_t prev)
+{
+	int i;
+
+	b->samples++;
+	for (i = 0; i < __UQMI_KPI_SIGNAL_MAX; i++) {
+		int val = r->signal[i][idx];
+
+		if (val == UQMI_KPI_NO_SIGNAL)
+			continue;
+
+		if (!b->signal[i].n || val < b->signal[i].min)
+			b->signal[i].min = val;
+		if (!b->signal[i].n || val > b->signal[i].max)
+			b->signal[i].max = val;
+		b->signal[i].sum += val;
+		b->signal[i].n++;
+	}
+
+	if (prev == idx)
+		return;
+
+	/* the counters restart with every data session */
+	for (i = 0; i < __UQMI_KPI_COUNTER_MAX; i++) {
+		uint64_t cur = r->counter[i][idx], last = r->counter[i][prev];
+
+		if (cur == UQMI_KPI_NO_COUNTER || last == UQMI_KPI_NO_COUNTER)
+			continue;
+
+		b->bytes[i] += cur >= last ? cur - last : cur;
+	}
+
+	if (r->registration[idx] != r->registration[prev] ||
+	    r->radio[idx] != r->radio[prev])
+		b->changes++;
+}
+
+static void kpi_add_bucket(struct blob_buf *buf, struct kpi_bucket *b, uint32_t start)
+{
+	void *c, *s;
+	int i;
+
+	c = blobmsg_open_table(buf, NULL);
+	blobmsg_add_u64(buf, "start", start);
+	blobmsg_add_u32(buf, "samples", b->samples);
+	for (i = 0; i < __UQMI_KPI_SIGNAL_MAX; i++) {
+		if (!b->signal[i].n)
+			continue;
+
+		s = blobmsg_open_table(buf, kpi_signal_names[i]);
+		blobmsg_add_u32(buf, "min", b->signal[i].min);
+		blobmsg_add_u32(buf, "max", b->signal[i].max);
+		blobmsg_add_double(buf, "avg", (double) b->signal[i].sum / b->signal[i].n);
+		blobmsg_close_table(buf, s);
+	}
+	for (i = 0; i < __UQMI_KPI_COUNTER_MAX; i++)
+		blobmsg_add_u64(buf, kpi_counter_names[i], b->bytes[i]);
+	blobmsg_add_u32(buf, "serving_system_changes", b->changes);
+	blobmsg_close_table(buf, c);
+}
+
+/*
+ * Summarize the samples of the last <window> seconds in buckets of <step>
+ * seconds each, with min/max/avg for the signal metrics, the number of bytes
+ * transferred and the number of registration or radio changes.
+ */
+int uqmi_kpi_query(const char *path, char *arg, bool single_line)
+{
+	const struct uqmi_kpi_ring *ring;
+	struct uqmi_kpi_ring *r = NULL;
+	struct kpi_bucket *buckets = NULL;
+	struct blob_buf buf = {};
+	uint32_t window, step, now, start, n_buckets, n, idx, prev, i;
+	char *err;
+	void *c, *a;
+	int ret = -1;
+
+	window = strtoul(arg, &err, 10);
+	step = window;
+	if (*err == ',')
+		step = strtoul(err + 1, &err, 10);
+	if (*err || !window || !step || step > window ||
+	    (window + step - 1) / step > UQMI_KPI_MAX_BUCKETS) {
+		fprintf(stderr, "Invalid query '%s' (<window>[,<step>] in seconds)\n", arg);
+		return -1;
+	}
+
+	ring = uqmi_shm_map(path, sizeof(*ring), false);
+	if (!ring) {
+		fprintf(stderr, "No KPI samples recorded at %s\n", path);
+		return -1;
+	}
+
+	if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != UQMI_KPI_MAGIC ||
+	    ring->version != UQMI_KPI_VERSION) {
+		fprintf(stderr, "Invalid KPI file %s\n", path);
+		goto out;
+	}
+
+	n_buckets = (window + step - 1) / step;
+	r = malloc(sizeof(*r));
+	buckets = calloc(n_buckets, sizeof(*buckets));
+	if (!r || !buckets || kpi_read(ring, r)) {
+		fprintf(stderr, "Failed to read KPI file %s\n", path);
+		goto out;
+	}
+
+	now = time(NULL);
+	start = now - window;
+	n = r->head < UQMI_KPI_SAMPLES ? r->head : UQMI_KPI_SAMPLES;
+	prev = (r->head - n) % UQMI_KPI_SAMPLES;
+	for (i = r->head - n; i != r->head; i++) {
+		idx = i % UQMI_KPI_SAMPLES;
+		if (r->time[idx] >= start && r->time[idx] <= now) {
+			uint32_t b = (r->time[idx] - start) / step;
+
+			kpi_add_sample(&buckets[b < n_buckets ? b : n_buckets - 1], r, idx, prev);
+		}
+		prev = idx;
+	}
+
+	blob_buf_init(&buf, 0);
+	c = blobmsg_open_table(&buf, NULL);
+	blobmsg_add_u32(&buf, "window", window);
+	blobmsg_add_u32(&buf, "step", step);
+	a = blobmsg_open_array(&buf, "buckets");
+	for (i = 0; i < n_buckets; i++)
+		kpi_add_bucket(&buf, &buckets[i], start + i * step);
+	blobmsg_close_array(&buf, a);
+	blobmsg_close_table(&buf, c);
+
+	uqmi_output_json(stdout, blob_data(buf.head), single_line ? -1 : 0);
+	ret = 0;
+	blob_buf_free(&buf);
+
+out:
+	free(buckets);
+	free(r);
+	munmap((void *) ring, sizeof(*ring));
+	return ret;
+}
@@ -0,0 +1,75 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __UQMI_KPI_H
+#define __UQMI_KPI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define UQMI_KPI_MAGIC		0x4b494d55	/* "UMIK" */
+#define UQMI_KPI_VERSION	1
+#define UQMI_KPI_SAMPLES	4096
+
+#define UQMI_KPI_NO_SIGNAL	INT16_MIN
+#define UQMI_KPI_NO_COUNTER	UINT64_MAX
+#define UQMI_KPI_NO_STATE	0xff
+
+enum uqmi_kpi_signal {
+	UQMI_KPI_RSSI,
+	UQMI_KPI_RSRP,
+	UQMI_KPI_RSRQ,
+	UQMI_KPI_SNR,
+	__UQMI_KPI_SIGNAL_MAX
+};
+
+enum uqmi_kpi_counter {
+	UQMI_KPI_RX_BYTES,
+	UQMI_KPI_TX_BYTES,
+	__UQMI_KPI_COUNTER_MAX
+};
+
+/*
+ * Fixed size ring of radio samples, stored column by column so that a query
+ * over one metric touches only the memory of that metric. head counts all
+ * samples ever written, the newest one is at (head - 1) % UQMI_KPI_SAMPLES.
+ * Updates are guarded by seq like the status segment.
+ */
+struct uqmi_kpi_ring {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq;
+	uint32_t head;
+
+	uint32_t time[UQMI_KPI_SAMPLES];
+	int16_t signal[__UQMI_KPI_SIGNAL_MAX][UQMI_KPI_SAMPLES];
+	uint64_t counter[__UQMI_KPI_COUNTER_MAX][UQMI_KPI_SAMPLES];
+	uint8_t registration[UQMI_KPI_SAMPLES];
+	uint8_t radio[UQMI_KPI_SAMPLES];
+};
+
+struct blob_attr;
+
+int uqmi_kpi_open(const char *path);
+bool uqmi_kpi_enabled(void);
+void uqmi_kpi_add(struct blob_attr *data);
+void uqmi_kpi_close(void);
+int uqmi_kpi_query(const char *path, char *arg, bool single_line);
+
+#endif
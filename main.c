@@ -23,6 +23,7 @@
 #include <libubox/utils.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -31,8 +32,17 @@
 
 #include "uqmi.h"
 #include "commands.h"
+#include "cache.h"
+#include "shm.h"
+#include "kpi.h"
+#include "output.h"
 
 static const char *device;
+static const char *cache_dir;
+static const char *read_status;
+static const char *decode_blob;
+static const char *kpi_file;
+static char *kpi_query;
 
 #define CMD_OPT(_arg) (-2 - _arg)
 
@@ -40,11 +50,17 @@ static const char *device;
 static const struct option uqmi_getopt[] = {
 	__uqmi_commands,
 	{ "single", no_argument, NULL, 's' },
+	{ "format", required_argument, NULL, 'f' },
 	{ "device", required_argument, NULL, 'd' },
 	{ "keep-client-id", required_argument, NULL, 'k' },
 	{ "release-client-id", required_argument, NULL, 'r' },
 	{ "mbim",  no_argument, NULL, 'm' },
 	{ "timeout", required_argument, NULL, 't' },
+	{ "cache-dir", required_argument, NULL, 'c' },
+	{ "read-status", required_argument, NULL, 'S' },
+	{ "decode", required_argument, NULL, 'D' },
+	{ "kpi-file", required_argument, NULL, 'K' },
+	{ "kpi-query", required_argument, NULL, 'Q' },
 	{ NULL, 0, NULL, 0 }
 };
 #undef __uqmi_command
@@ -54,11 +70,19 @@ static int usage(const char *progname)
 	fprintf(stderr, "Usage: %s <options|actions>\n"
 		"Options:\n"
 		"  --single, -s:                     Print output as a single line (for scripts)\n"
+		"  --format <fmt>:                   Output format: json (default), shell for\n"
+		"                                    KEY='value' lines (nested keys joined with _)\n"
+		"                                    or blob for binary blobmsg records\n"
+		"  --decode <file>:                  Print the records of a --format blob dump\n"
+		"                                    (- for stdin, does not need --device)\n"
 		"  --device=NAME, -d NAME:           Set device name to NAME (required)\n"
 		"  --keep-client-id <name>:          Keep Client ID for service <name>\n"
 		"  --release-client-id <name>:       Release Client ID after exiting\n"
 		"  --mbim, -m                        NAME is an MBIM device with EXT_QMUX support\n"
 		"  --timeout, -t                     response timeout in msecs\n"
+		"  --cache-dir <dir>:                Cache versions, IMEI, ICCID, model, revision and\n"
+		"                                    capabilities in <dir>, discarded when the modem\n"
+		"                                    enumerates again (reset, firmware update)\n"
 		"\n"
 		"Services:                           dms, nas, pds, wds, wms\n"
 		"\n"
@@ -69,6 +93,21 @@ static int usage(const char *progname)
 		"  --get-client-id <name>:           Connect and get Client ID for service <name>\n"
 		"                                    (implies --keep-client-id)\n"
 		"  --sync:                           Release all Client IDs\n"
+		"  --status-all:                     Query PIN, card, serving system, signal, data status,\n"
+		"                                    IMEI, ICCID and capabilities at once\n"
+		"  --prometheus-textfile <file>:     Write status, identity and packet statistics as\n"
+		"                                    Prometheus metrics to <file> (- for stdout)\n"
+		"  --publish-status <file>:          Keep the current status in a shared memory file\n"
+		"                                    (e.g. /dev/shm/uqmi-status) until interrupted\n"
+		"    --publish-interval <ms>:        Update interval (default: 5000)\n"
+		"  --read-status <file>:             Print the status published in <file>\n"
+		"                                    (does not need --device)\n"
+		"  --kpi-file <file>:                Record signal, registration and byte counters\n"
+		"                                    of every --publish-status update in <file>\n"
+		"  --kpi-query <window>[,<step>]:    Print min/max/avg signal, transferred bytes and\n"
+		"                                    serving system changes recorded in --kpi-file\n"
+		"                                    over the last <window> seconds, in buckets of\n"
+		"                                    <step> seconds (does not need --device)\n"
 		wds_helptext
 		dms_helptext
 		uim_helptext
@@ -143,17 +182,57 @@ int main(int argc, char **argv)
 		case 's':
 			single_line = true;
 			break;
+		case 'f':
+			if (!strcmp(optarg, "json"))
+				output_format = UQMI_OUTPUT_JSON;
+			else if (!strcmp(optarg, "shell"))
+				output_format = UQMI_OUTPUT_SHELL;
+			else if (!strcmp(optarg, "blob"))
+				output_format = UQMI_OUTPUT_BLOB;
+			else
+				return usage(argv[0]);
+			break;
 		case 'm':
 			dev.is_mbim = true;
 			break;
 		case 't':
 			uloop_timeout_set(&request_timeout, atol(optarg));
 			break;
+		case 'c':
+			cache_dir = optarg;
+			break;
+		case 'S':
+			read_status = optarg;
+			break;
+		case 'D':
+			decode_blob = optarg;
+			break;
+		case 'K':
+			kpi_file = optarg;
+			break;
+		case 'Q':
+			kpi_query = optarg;
+			break;
 		default:
 			return usage(argv[0]);
 		}
 	}
 
+	if (read_status)
+		return uqmi_shm_dump(read_status) ? 2 : 0;
+
+	if (decode_blob)
+		return uqmi_decode_blob(decode_blob) ? 2 : 0;
+
+	if (kpi_query) {
+		if (!kpi_file) {
+			fprintf(stderr, "No KPI file given\n");
+			return usage(argv[0]);
+		}
+
+		return uqmi_kpi_query(kpi_file, kpi_query, single_line) ? 2 : 0;
+	}
+
 	if (!device) {
 		fprintf(stderr, "No device given\n");
 		return usage(argv[0]);
@@ -164,8 +243,16 @@ int main(int argc, char **argv)
 		return 2;
 	}
 
+	if (cache_dir && uqmi_cache_init(cache_dir, device))
+		fprintf(stderr, "Failed to initialize cache\n");
+
+	if (kpi_file && uqmi_kpi_open(kpi_file))
+		fprintf(stderr, "Failed to open KPI file %s\n", kpi_file);
+
 	ret = uqmi_run_commands(&dev) ? 0 : -1;
 
+	uqmi_cache_done();
+	uqmi_kpi_close();
 	qmi_device_close(&dev);
 
 	return ret;
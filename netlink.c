@@ -0,0 +1,288 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_addr.h>
+#include <net/if.h>
+
+#include "netlink.h"
+
+#define NETLINK_MAX_FLUSH	16
+
+struct netlink_req {
+	struct nlmsghdr n;
+	union {
+		struct ifinfomsg ifi;
+		struct ifaddrmsg ifa;
+		struct rtmsg rtm;
+	};
+	char attrbuf[256];
+};
+
+static int nl_fd = -1;
+static uint32_t nl_seq;
+
+static int netlink_open(void)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+	};
+
+	if (nl_fd >= 0)
+		return 0;
+
+	nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (nl_fd < 0)
+		return -errno;
+
+	if (bind(nl_fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+		close(nl_fd);
+		nl_fd = -1;
+		return -errno;
+	}
+
+	return 0;
+}
+
+static void
+netlink_add_attr(struct netlink_req *req, int type, const void *data, int len)
+{
+	struct rtattr *rta = (void *) ((char *) &req->n + NLMSG_ALIGN(req->n.nlmsg_len));
+
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	memcpy(RTA_DATA(rta), data, len);
+	req->n.nlmsg_len = NLMSG_ALIGN(req->n.nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+static void
+netlink_init_req(struct netlink_req *req, int type, int flags, int len)
+{
+	memset(req, 0, sizeof(*req));
+	req->n.nlmsg_len = NLMSG_LENGTH(len);
+	req->n.nlmsg_type = type;
+	req->n.nlmsg_flags = NLM_F_REQUEST | flags;
+	req->n.nlmsg_seq = ++nl_seq;
+}
+
+static int netlink_send(struct netlink_req *req)
+{
+	int ret;
+
+	ret = netlink_open();
+	if (ret)
+		return ret;
+
+	if (send(nl_fd, &req->n, req->n.nlmsg_len, 0) < 0)
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * Read replies to the request with sequence number seq. Messages other than
+ * errors and the end of a dump are passed to cb, if given.
+ */
+static int
+netlink_recv(uint32_t seq, void (*cb)(struct nlmsghdr *n, void *priv), void *priv)
+{
+	static char buf[8192];
+	struct nlmsghdr *n;
+	struct nlmsgerr *err;
+	int len;
+
+	while (1) {
+		len = recv(nl_fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		for (n = (void *) buf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+			if (n->nlmsg_seq != seq)
+				continue;
+
+			switch (n->nlmsg_type) {
+			case NLMSG_DONE:
+				return 0;
+			case NLMSG_ERROR:
+				err = NLMSG_DATA(n);
+				return err->error;
+			default:
+				if (cb)
+					cb(n, priv);
+				break;
+			}
+		}
+	}
+}
+
+static int netlink_talk(struct netlink_req *req)
+{
+	int ret;
+
+	req->n.nlmsg_flags |= NLM_F_ACK;
+	ret = netlink_send(req);
+	if (ret)
+		return ret;
+
+	return netlink_recv(req->n.nlmsg_seq, NULL, NULL);
+}
+
+int netlink_set_link_up(int ifindex, unsigned int mtu)
+{
+	struct netlink_req req;
+
+	netlink_init_req(&req, RTM_NEWLINK, 0, sizeof(req.ifi));
+	req.ifi.ifi_family = AF_UNSPEC;
+	req.ifi.ifi_index = ifindex;
+	req.ifi.ifi_flags = IFF_UP;
+	req.ifi.ifi_change = IFF_UP;
+	if (mtu)
+		netlink_add_attr(&req, IFLA_MTU, &mtu, sizeof(mtu));
+
+	return netlink_talk(&req);
+}
+
+struct netlink_flush {
+	int ifindex;
+	int n_addr;
+	struct {
+		struct ifaddrmsg ifa;
+		struct in6_addr addr;
+	} addr[NETLINK_MAX_FLUSH];
+};
+
+static void netlink_flush_cb(struct nlmsghdr *n, void *priv)
+{
+	struct netlink_flush *f = priv;
+	struct ifaddrmsg *ifa = NLMSG_DATA(n);
+	struct rtattr *rta = IFA_RTA(ifa);
+	int len = IFA_PAYLOAD(n);
+
+	if (n->nlmsg_type != RTM_NEWADDR || ifa->ifa_index != f->ifindex)
+		return;
+
+	/* keep the IPv6 link-local address */
+	if (ifa->ifa_scope == RT_SCOPE_LINK || f->n_addr >= NETLINK_MAX_FLUSH)
+		return;
+
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type != IFA_ADDRESS ||
+		    RTA_PAYLOAD(rta) > sizeof(f->addr[0].addr))
+			continue;
+
+		f->addr[f->n_addr].ifa = *ifa;
+		memcpy(&f->addr[f->n_addr].addr, RTA_DATA(rta), RTA_PAYLOAD(rta));
+		f->n_addr++;
+		break;
+	}
+}
+
+int netlink_flush_addresses(int ifindex, int family)
+{
+	static struct netlink_flush f;
+	struct netlink_req req;
+	int alen = family == AF_INET ? 4 : 16;
+	int ret, i;
+
+	netlink_init_req(&req, RTM_GETADDR, NLM_F_DUMP, sizeof(req.ifa));
+	req.ifa.ifa_family = family;
+	ret = netlink_send(&req);
+	if (ret)
+		return ret;
+
+	memset(&f, 0, sizeof(f));
+	f.ifindex = ifindex;
+	ret = netlink_recv(req.n.nlmsg_seq, netlink_flush_cb, &f);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < f.n_addr; i++) {
+		netlink_init_req(&req, RTM_DELADDR, 0, sizeof(req.ifa));
+		req.ifa = f.addr[i].ifa;
+		netlink_add_attr(&req, IFA_LOCAL, &f.addr[i].addr, alen);
+		netlink_add_attr(&req, IFA_ADDRESS, &f.addr[i].addr, alen);
+
+		ret = netlink_talk(&req);
+		if (ret && ret != -EADDRNOTAVAIL)
+			return ret;
+	}
+
+	return 0;
+}
+
+int netlink_add_address(int ifindex, int family, const void *addr, int prefixlen)
+{
+	struct netlink_req req;
+	int alen = family == AF_INET ? 4 : 16;
+
+	netlink_init_req(&req, RTM_NEWADDR, NLM_F_CREATE | NLM_F_REPLACE, sizeof(req.ifa));
+	req.ifa.ifa_family = family;
+	req.ifa.ifa_prefixlen = prefixlen;
+	req.ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+	req.ifa.ifa_index = ifindex;
+
+	/* the modem already did duplicate address detection */
+	if (family == AF_INET6)
+		req.ifa.ifa_flags = IFA_F_NODAD;
+
+	netlink_add_attr(&req, IFA_LOCAL, addr, alen);
+	netlink_add_attr(&req, IFA_ADDRESS, addr, alen);
+
+	return netlink_talk(&req);
+}
+
+/*
+ * Add or update the default route through ifindex at the given metric.
+ * Only a default route with the same metric is replaced, so with a metric
+ * of its own the route sits next to the other uplinks of the host.
+ */
+int netlink_add_default_route(int ifindex, int family, const void *gateway,
+			      uint32_t metric)
+{
+	struct netlink_req req;
+	int alen = family == AF_INET ? 4 : 16;
+
+	netlink_init_req(&req, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE, sizeof(req.rtm));
+	req.rtm.rtm_family = family;
+	req.rtm.rtm_table = RT_TABLE_MAIN;
+	req.rtm.rtm_protocol = RTPROT_BOOT;
+	req.rtm.rtm_type = RTN_UNICAST;
+
+	if (gateway) {
+		/* the gateway is not necessarily inside the assigned subnet */
+		req.rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+		req.rtm.rtm_flags = RTNH_F_ONLINK;
+		netlink_add_attr(&req, RTA_GATEWAY, gateway, alen);
+	} else {
+		req.rtm.rtm_scope = RT_SCOPE_LINK;
+	}
+	netlink_add_attr(&req, RTA_OIF, &ifindex, sizeof(ifindex));
+	netlink_add_attr(&req, RTA_PRIORITY, &metric, sizeof(metric));
+
+	return netlink_talk(&req);
+}
@@ -0,0 +1,35 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __UQMI_NETLINK_H
+#define __UQMI_NETLINK_H
+
+#include <stdint.h>
+
+/*
+ * Minimal rtnetlink helpers for configuring the network interface of a
+ * data session. All functions return 0 on success or a negative errno.
+ */
+int netlink_set_link_up(int ifindex, unsigned int mtu);
+int netlink_flush_addresses(int ifindex, int family);
+int netlink_add_address(int ifindex, int family, const void *addr, int prefixlen);
+int netlink_add_default_route(int ifindex, int family, const void *gateway,
+			      uint32_t metric);
+
+#endif
@@ -0,0 +1,614 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+#include <libubox/blobmsg.h>
+
+#include "output.h"
+
+#define PROM_PREFIX	"uqmi"
+#define BLOB_MAX_LEN	(1024 * 1024)
+
+struct json_writer {
+	FILE *f;
+	bool indent;
+	int indent_level;
+};
+
+static void json_separator(struct json_writer *w)
+{
+	static const char indent_chars[] = "\n\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+	int len;
+
+	if (!w->indent)
+		return;
+
+	len = w->indent_level + 1;
+	if (len > sizeof(indent_chars) - 1)
+		len = sizeof(indent_chars) - 1;
+
+	fwrite(indent_chars, 1, len, w->f);
+}
+
+static void json_string(struct json_writer *w, const char *str)
+{
+	const unsigned char *p;
+
+	fputc('"', w->f);
+	for (p = (const unsigned char *) str; *p; p++) {
+		switch (*p) {
+		case '\b':
+			fputs("\\b", w->f);
+			break;
+		case '\n':
+			fputs("\\n", w->f);
+			break;
+		case '\t':
+			fputs("\\t", w->f);
+			break;
+		case '\r':
+			fputs("\\r", w->f);
+			break;
+		case '"':
+		case '\\':
+			fputc('\\', w->f);
+			fputc(*p, w->f);
+			break;
+		default:
+			if (*p < ' ')
+				fprintf(w->f, "\\u00%02x", *p);
+			else
+				fputc(*p, w->f);
+			break;
+		}
+	}
+	fputc('"', w->f);
+}
+
+static void json_element(struct json_writer *w, struct blob_attr *attr, bool without_name);
+
+static void json_list(struct json_writer *w, struct blob_attr *attr, bool array)
+{
+	struct blob_attr *pos;
+	bool first = true;
+	int rem;
+
+	fputc(array ? '[' : '{', w->f);
+	w->indent_level++;
+	json_separator(w);
+	blobmsg_for_each_attr(pos, attr, rem) {
+		if (!first) {
+			fputc(',', w->f);
+			json_separator(w);
+		}
+
+		json_element(w, pos, array);
+		first = false;
+	}
+	w->indent_level--;
+	json_separator(w);
+	fputc(array ? ']' : '}', w->f);
+}
+
+static void json_element(struct json_writer *w, struct blob_attr *attr, bool without_name)
+{
+	if (!without_name && blobmsg_name(attr)[0]) {
+		json_string(w, blobmsg_name(attr));
+		fputs(w->indent ? ": " : ":", w->f);
+	}
+
+	switch (blobmsg_type(attr)) {
+	case BLOBMSG_TYPE_UNSPEC:
+		fputs("null", w->f);
+		break;
+	case BLOBMSG_TYPE_BOOL:
+		fputs(blobmsg_get_u8(attr) ? "true" : "false", w->f);
+		break;
+	case BLOBMSG_TYPE_INT16:
+		fprintf(w->f, "%" PRId16, (int16_t) blobmsg_get_u16(attr));
+		break;
+	case BLOBMSG_TYPE_INT32:
+		fprintf(w->f, "%" PRId32, (int32_t) blobmsg_get_u32(attr));
+		break;
+	case BLOBMSG_TYPE_INT64:
+		fprintf(w->f, "%" PRId64, (int64_t) blobmsg_get_u64(attr));
+		break;
+	case BLOBMSG_TYPE_DOUBLE:
+		fprintf(w->f, "%lf", blobmsg_get_double(attr));
+		break;
+	case BLOBMSG_TYPE_STRING:
+		json_string(w, blobmsg_get_string(attr));
+		break;
+	case BLOBMSG_TYPE_ARRAY:
+		json_list(w, attr, true);
+		break;
+	case BLOBMSG_TYPE_TABLE:
+		json_list(w, attr, false);
+		break;
+	}
+}
+
+/*
+ * Write a result as JSON straight into a (buffered) stream. The output is
+ * the same as with blobmsg_format_json_indent(), but without building the
+ * whole text in a separate buffer first, which matters for large results
+ * like network scans or message lists. indent < 0 means a single line.
+ */
+void uqmi_output_json(FILE *f, struct blob_attr *attr, int indent)
+{
+	struct json_writer w = {
+		.f = f,
+		.indent = indent >= 0,
+		.indent_level = indent >= 0 ? indent : 0,
+	};
+
+	json_element(&w, attr, false);
+	fputc('\n', f);
+}
+
+static bool blobmsg_is_number(struct blob_attr *attr)
+{
+	switch (blobmsg_type(attr)) {
+	case BLOBMSG_TYPE_INT8:
+	case BLOBMSG_TYPE_INT16:
+	case BLOBMSG_TYPE_INT32:
+	case BLOBMSG_TYPE_INT64:
+	case BLOBMSG_TYPE_DOUBLE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* metric and label names may only contain [a-zA-Z0-9_:] */
+static void prom_name(char *buf, int len, const char *prefix, const char *name)
+{
+	int i;
+
+	snprintf(buf, len, "%s%s%s", prefix ? prefix : "", prefix ? "_" : "", name);
+	for (i = 0; buf[i]; i++)
+		if (!isalnum(buf[i]) && buf[i] != '_' && buf[i] != ':')
+			buf[i] = '_';
+}
+
+static void prom_label_value(FILE *f, const char *str)
+{
+	for (; *str; str++) {
+		switch (*str) {
+		case '\\':
+			fputs("\\\\", f);
+			break;
+		case '"':
+			fputs("\\\"", f);
+			break;
+		case '\n':
+			fputs("\\n", f);
+			break;
+		default:
+			fputc(*str, f);
+			break;
+		}
+	}
+}
+
+static void prom_value(FILE *f, struct blob_attr *attr)
+{
+	switch (blobmsg_type(attr)) {
+	case BLOBMSG_TYPE_INT8:
+		fprintf(f, " %d\n", blobmsg_get_u8(attr));
+		break;
+	case BLOBMSG_TYPE_INT16:
+		fprintf(f, " %d\n", (int16_t) blobmsg_get_u16(attr));
+		break;
+	case BLOBMSG_TYPE_INT32:
+		fprintf(f, " %d\n", (int32_t) blobmsg_get_u32(attr));
+		break;
+	case BLOBMSG_TYPE_INT64:
+		fprintf(f, " %" PRIu64 "\n", blobmsg_get_u64(attr));
+		break;
+	case BLOBMSG_TYPE_DOUBLE:
+		fprintf(f, " %g\n", blobmsg_get_double(attr));
+		break;
+	default:
+		fputs(" 1\n", f);
+		break;
+	}
+}
+
+/*
+ * Table members exported as labels instead of metrics. A label member
+ * applies to the members following it in the same table, up to the next
+ * one: --get-signal-info reports one "type" per radio technology, each
+ * followed by the values for that technology. All other string members are
+ * exported as <name>_info{value="..."} 1, so the label set of a metric stays
+ * fixed no matter what the modem reports.
+ */
+static const char * const prom_label_members[] = {
+	"type",
+};
+
+struct prom_sample {
+	char name[128];
+	struct blob_attr *label;	/* current label member, if any */
+	struct blob_attr *value;	/* number, or string for _info metrics */
+	bool done;
+};
+
+struct prom_writer {
+	struct prom_sample *samples;
+	int n_samples;
+};
+
+static bool prom_is_label(struct blob_attr *attr)
+{
+	int i;
+
+	if (blobmsg_type(attr) != BLOBMSG_TYPE_STRING)
+		return false;
+
+	for (i = 0; i < sizeof(prom_label_members) / sizeof(prom_label_members[0]); i++)
+		if (!strcmp(blobmsg_name(attr), prom_label_members[i]))
+			return true;
+
+	return false;
+}
+
+static bool prom_same_label(struct blob_attr *a, struct blob_attr *b)
+{
+	if (!a || !b)
+		return a == b;
+
+	return !strcmp(blobmsg_name(a), blobmsg_name(b)) &&
+	       !strcmp(blobmsg_get_string(a), blobmsg_get_string(b));
+}
+
+static void prom_add(struct prom_writer *w, const char *name,
+		     struct blob_attr *label, struct blob_attr *value)
+{
+	struct prom_sample *s;
+	int i;
+
+	/* the exposition format does not allow the same sample twice */
+	for (i = 0; i < w->n_samples; i++) {
+		s = &w->samples[i];
+		if (!strcmp(s->name, name) && prom_same_label(s->label, label))
+			return;
+	}
+
+	s = realloc(w->samples, (w->n_samples + 1) * sizeof(*s));
+	if (!s)
+		return;
+
+	w->samples = s;
+	s = &s[w->n_samples++];
+	snprintf(s->name, sizeof(s->name), "%s", name);
+	s->label = label;
+	s->value = value;
+	s->done = false;
+}
+
+static void prom_add_member(struct prom_writer *w, const char *name,
+			    struct blob_attr *label, struct blob_attr *cur)
+{
+	char info[136];
+
+	if (blobmsg_type(cur) == BLOBMSG_TYPE_STRING) {
+		snprintf(info, sizeof(info), "%s_info", name);
+		prom_add(w, info, label, cur);
+	} else if (blobmsg_is_number(cur)) {
+		prom_add(w, name, label, cur);
+	}
+}
+
+static void prom_table(struct prom_writer *w, const char *prefix, struct blob_attr *table)
+{
+	struct blob_attr *cur, *label = NULL;
+	char name[128];
+	int rem;
+
+	blobmsg_for_each_attr(cur, table, rem) {
+		if (prom_is_label(cur)) {
+			label = cur;
+			continue;
+		}
+
+		prom_name(name, sizeof(name), prefix, blobmsg_name(cur));
+		if (blobmsg_type(cur) == BLOBMSG_TYPE_TABLE)
+			prom_table(w, name, cur);
+		else
+			prom_add_member(w, name, label, cur);
+	}
+}
+
+static void prom_sample(FILE *f, struct prom_sample *s)
+{
+	char name[64];
+	bool info = blobmsg_type(s->value) == BLOBMSG_TYPE_STRING;
+
+	fputs(s->name, f);
+	if (!s->label && !info) {
+		prom_value(f, s->value);
+		return;
+	}
+
+	fputc('{', f);
+	if (s->label) {
+		prom_name(name, sizeof(name), NULL, blobmsg_name(s->label));
+		fprintf(f, "%s=\"", name);
+		prom_label_value(f, blobmsg_get_string(s->label));
+		fprintf(f, "\"%s", info ? "," : "");
+	}
+	if (info) {
+		fputs("value=\"", f);
+		prom_label_value(f, blobmsg_get_string(s->value));
+		fputc('"', f);
+	}
+	fputc('}', f);
+	prom_value(f, s->value);
+}
+
+/* print all samples grouped by metric family, with one TYPE line each */
+static void prom_flush(FILE *f, struct prom_writer *w)
+{
+	int i, j;
+
+	for (i = 0; i < w->n_samples; i++) {
+		if (w->samples[i].done)
+			continue;
+
+		fprintf(f, "# TYPE %s gauge\n", w->samples[i].name);
+		for (j = i; j < w->n_samples; j++) {
+			if (w->samples[j].done ||
+			    strcmp(w->samples[j].name, w->samples[i].name) != 0)
+				continue;
+
+			prom_sample(f, &w->samples[j]);
+			w->samples[j].done = true;
+		}
+	}
+
+	free(w->samples);
+	w->samples = NULL;
+	w->n_samples = 0;
+}
+
+static bool prom_has_error(struct blob_attr *table)
+{
+	struct blob_attr *cur;
+	int rem;
+
+	blobmsg_for_each_attr(cur, table, rem)
+		if (!strcmp(blobmsg_name(cur), "error"))
+			return true;
+
+	return false;
+}
+
+/*
+ * Write a composite result table (as produced by --status-all) in the
+ * Prometheus text exposition format. Every member becomes a group of metrics
+ * named after it, and uqmi_query_success tells which of the queries failed.
+ */
+void uqmi_output_prometheus(FILE *f, struct blob_attr *data)
+{
+	struct prom_writer w = {};
+	struct blob_attr *cur;
+	char name[128];
+	bool ok;
+	int rem;
+
+	fprintf(f, "# TYPE " PROM_PREFIX "_query_success gauge\n");
+	blobmsg_for_each_attr(cur, data, rem) {
+		ok = blobmsg_type(cur) != BLOBMSG_TYPE_TABLE || !prom_has_error(cur);
+		fprintf(f, PROM_PREFIX "_query_success{query=\"");
+		prom_label_value(f, blobmsg_name(cur));
+		fprintf(f, "\"} %d\n", ok);
+	}
+
+	blobmsg_for_each_attr(cur, data, rem) {
+		prom_name(name, sizeof(name), PROM_PREFIX, blobmsg_name(cur));
+
+		if (blobmsg_type(cur) != BLOBMSG_TYPE_TABLE)
+			prom_add_member(&w, name, NULL, cur);
+		else if (!prom_has_error(cur))
+			prom_table(&w, name, cur);
+	}
+
+	prom_flush(f, &w);
+}
+
+/* shell variable names: upper case, [A-Z0-9_], not starting with a digit */
+static void shell_key(char *buf, int len, const char *prefix, const char *name)
+{
+	int i;
+
+	snprintf(buf, len, "%s%s%s", prefix, *prefix ? "_" : "", name);
+	for (i = 0; buf[i]; i++) {
+		if (isalnum(buf[i]))
+			buf[i] = toupper(buf[i]);
+		else
+			buf[i] = '_';
+	}
+
+	if (isdigit(buf[0]))
+		buf[0] = '_';
+}
+
+static void shell_value(FILE *f, struct blob_attr *attr)
+{
+	const char *str;
+
+	switch (blobmsg_type(attr)) {
+	case BLOBMSG_TYPE_BOOL:
+		fprintf(f, "%d", !!blobmsg_get_u8(attr));
+		break;
+	case BLOBMSG_TYPE_INT16:
+		fprintf(f, "%d", (int16_t) blobmsg_get_u16(attr));
+		break;
+	case BLOBMSG_TYPE_INT32:
+		fprintf(f, "%" PRId32, (int32_t) blobmsg_get_u32(attr));
+		break;
+	case BLOBMSG_TYPE_INT64:
+		fprintf(f, "%" PRId64, (int64_t) blobmsg_get_u64(attr));
+		break;
+	case BLOBMSG_TYPE_DOUBLE:
+		fprintf(f, "%lf", blobmsg_get_double(attr));
+		break;
+	case BLOBMSG_TYPE_STRING:
+		/* single quotes, a quote inside is written as '\'' */
+		for (str = blobmsg_get_string(attr); *str; str++) {
+			if (*str == '\'')
+				fputs("'\\''", f);
+			else
+				fputc(*str, f);
+		}
+		break;
+	}
+}
+
+static bool shell_is_list(struct blob_attr *attr)
+{
+	struct blob_attr *cur;
+	int rem;
+
+	blobmsg_for_each_attr(cur, attr, rem)
+		if (blobmsg_type(cur) == BLOBMSG_TYPE_TABLE ||
+		    blobmsg_type(cur) == BLOBMSG_TYPE_ARRAY)
+			return false;
+
+	return true;
+}
+
+static void shell_element(FILE *f, const char *key, struct blob_attr *attr)
+{
+	struct blob_attr *cur;
+	char name[128];
+	bool first = true;
+	int rem, i = 0;
+
+	switch (blobmsg_type(attr)) {
+	case BLOBMSG_TYPE_TABLE:
+		blobmsg_for_each_attr(cur, attr, rem) {
+			shell_key(name, sizeof(name), key, blobmsg_name(cur));
+			shell_element(f, name, cur);
+		}
+		break;
+	case BLOBMSG_TYPE_ARRAY:
+		/* plain values become a space separated list, e.g. for DNS servers */
+		if (shell_is_list(attr)) {
+			fprintf(f, "%s='", key);
+			blobmsg_for_each_attr(cur, attr, rem) {
+				if (!first)
+					fputc(' ', f);
+				shell_value(f, cur);
+				first = false;
+			}
+			fputs("'\n", f);
+			break;
+		}
+
+		blobmsg_for_each_attr(cur, attr, rem) {
+			snprintf(name, sizeof(name), "%s_%d", key, i++);
+			shell_element(f, name, cur);
+		}
+		break;
+	default:
+		fprintf(f, "%s='", key);
+		shell_value(f, attr);
+		fputs("'\n", f);
+		break;
+	}
+}
+
+/*
+ * Write a result as KEY='value' lines which can be passed to eval. Nested
+ * tables are flattened (ipv4.ip becomes IPV4_IP), a result that is not a
+ * table is assigned to a variable named after the command.
+ */
+void uqmi_output_shell(FILE *f, struct blob_attr *attr, const char *name)
+{
+	char key[128];
+
+	if (blobmsg_type(attr) == BLOBMSG_TYPE_TABLE) {
+		shell_element(f, "", attr);
+		return;
+	}
+
+	if (!strncmp(name, "get-", 4))
+		name += 4;
+
+	shell_key(key, sizeof(key), "", name);
+	shell_element(f, key, attr);
+}
+
+/*
+ * Binary output: every result is written as the raw blobmsg attribute, so it
+ * needs no formatting at all. Each record starts with a 32 bit big endian
+ * header: bit 31 is set (blobmsg), bits 24-30 hold the type and bits 0-23
+ * the length including the header. It is followed by the name (16 bit big
+ * endian length, the name and a NUL byte, padded to 4 bytes) and the data,
+ * and the whole record is padded to a multiple of 4 bytes. Consumers linked
+ * against libubox can use blobmsg_parse() etc. on the record directly.
+ */
+void uqmi_output_blob(FILE *f, struct blob_attr *attr)
+{
+	fwrite(attr, blob_pad_len(attr), 1, f);
+}
+
+/*
+ * Read the next record of a binary output stream into *attr. Returns 1 for
+ * a record, 0 at the end of the stream and -1 for a truncated or invalid
+ * record.
+ */
+int uqmi_blob_read(FILE *f, struct blob_attr **attr)
+{
+	struct blob_attr hdr, *cur;
+	unsigned int len;
+	size_t n;
+
+	*attr = NULL;
+	n = fread(&hdr, 1, sizeof(hdr), f);
+	if (!n && feof(f))
+		return 0;
+	if (n != sizeof(hdr))
+		return -1;
+
+	len = blob_pad_len(&hdr);
+	if (len <= sizeof(hdr) || len > BLOB_MAX_LEN)
+		return -1;
+
+	cur = malloc(len);
+	if (!cur)
+		return -1;
+
+	memcpy(cur, &hdr, sizeof(hdr));
+	if (fread(cur->data, len - sizeof(hdr), 1, f) != 1 ||
+	    !blobmsg_check_attr(cur, false)) {
+		free(cur);
+		return -1;
+	}
+
+	*attr = cur;
+	return 1;
+}
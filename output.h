@@ -0,0 +1,41 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __UQMI_OUTPUT_H
+#define __UQMI_OUTPUT_H
+
+#include <stdio.h>
+
+struct blob_attr;
+
+enum uqmi_output_format {
+	UQMI_OUTPUT_JSON,
+	UQMI_OUTPUT_SHELL,
+	UQMI_OUTPUT_BLOB,
+};
+
+extern enum uqmi_output_format output_format;
+
+void uqmi_output_json(FILE *f, struct blob_attr *attr, int indent);
+void uqmi_output_shell(FILE *f, struct blob_attr *attr, const char *name);
+void uqmi_output_prometheus(FILE *f, struct blob_attr *data);
+void uqmi_output_blob(FILE *f, struct blob_attr *attr);
+int uqmi_blob_read(FILE *f, struct blob_attr **attr);
+
+#endif
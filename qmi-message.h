@@ -101,6 +101,7 @@ enum {
 	QMI_ERROR_NO_DATA = -1,
 	QMI_ERROR_INVALID_DATA = -2,
 	QMI_ERROR_CANCELLED = -3,
+	QMI_ERROR_TIMEOUT = -4,
 };
 
 #define QMI_BUFFER_LEN 2048
@@ -0,0 +1,191 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+
+#define UQMI_SHM_READ_RETRIES	1000
+
+static struct uqmi_shm *shm;
+static size_t shm_size;
+
+/*
+ * Map a shared file of the given size, read-write for the publisher (which
+ * creates it) or read-only for readers. Returns NULL and sets errno on error.
+ */
+void *uqmi_shm_map(const char *path, size_t size, bool create)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (create)
+		fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	else
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (create ? ftruncate(fd, size) < 0 : fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	if (!create && st.st_size < size) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	map = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ,
+		   MAP_SHARED, fd, 0);
+	close(fd);
+
+	return map == MAP_FAILED ? NULL : map;
+}
+
+int uqmi_shm_create(const char *path)
+{
+	size_t size = sizeof(*shm) + UQMI_SHM_DATA_SIZE;
+
+	shm = uqmi_shm_map(path, size, true);
+	if (!shm)
+		return -errno;
+
+	shm_size = size;
+
+	/* keep counting from a previous publisher, but never start inside an update */
+	if (shm->magic != UQMI_SHM_MAGIC || shm->version != UQMI_SHM_VERSION)
+		memset(shm, 0, sizeof(*shm));
+	else if (shm->seq & 1)
+		shm->seq++;
+
+	shm->size = UQMI_SHM_DATA_SIZE;
+	shm->version = UQMI_SHM_VERSION;
+	__atomic_store_n(&shm->magic, UQMI_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+int uqmi_shm_update(const char *data, unsigned int len)
+{
+	uint32_t seq;
+
+	if (!shm)
+		return -EINVAL;
+
+	if (len > shm->size)
+		return -E2BIG;
+
+	seq = uqmi_seq_write_begin(&shm->seq);
+	memcpy(shm->data, data, len);
+	shm->len = len;
+	uqmi_seq_write_end(&shm->seq, seq);
+
+	return 0;
+}
+
+void uqmi_shm_close(void)
+{
+	if (!shm)
+		return;
+
+	munmap(shm, shm_size);
+	shm = NULL;
+}
+
+/* copy a consistent snapshot out of the segment, without blocking the writer */
+static int uqmi_shm_read(const struct uqmi_shm *s, size_t size, char *buf)
+{
+	uint32_t seq, len;
+	int i;
+
+	for (i = 0; i < UQMI_SHM_READ_RETRIES; i++) {
+		seq = uqmi_seq_read_begin(&s->seq);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		len = s->len;
+		if (len > size)
+			len = size;
+		memcpy(buf, s->data, len);
+
+		if (!uqmi_seq_read_retry(&s->seq, seq))
+			return len;
+	}
+
+	return -EAGAIN;
+}
+
+int uqmi_shm_dump(const char *path)
+{
+	const struct uqmi_shm *s;
+	struct stat st;
+	size_t size;
+	char *buf;
+	void *map;
+	int fd, len;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < sizeof(*s)) {
+		fprintf(stderr, "No status published at %s\n", path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s\n", path);
+		return -1;
+	}
+
+	s = map;
+	size = st.st_size - sizeof(*s);
+	if (__atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != UQMI_SHM_MAGIC ||
+	    s->version != UQMI_SHM_VERSION || s->size > size) {
+		fprintf(stderr, "Invalid status segment %s\n", path);
+		len = -1;
+		goto out;
+	}
+
+	buf = malloc(s->size);
+	len = buf ? uqmi_shm_read(s, s->size, buf) : -ENOMEM;
+	if (len > 0)
+		printf("%.*s\n", len, buf);
+	else if (len < 0)
+		fprintf(stderr, "Failed to read status segment %s\n", path);
+	free(buf);
+
+out:
+	munmap(map, st.st_size);
+	return len < 0 ? -1 : 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * uqmi -- tiny QMI support implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __UQMI_SHM_H
+#define __UQMI_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define UQMI_SHM_MAGIC		0x494d5155	/* "UQMI" */
+#define UQMI_SHM_VERSION	1
+#define UQMI_SHM_DATA_SIZE	(32 * 1024)
+
+/*
+ * Status segment shared between one publisher and any number of readers.
+ * The publisher makes seq odd while it updates the data and even again
+ * afterwards; readers retry until they saw the same even seq before and
+ * after copying the data (see the uqmi_seq_* helpers below).
+ */
+struct uqmi_shm {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t seq;
+	uint32_t len;
+	char data[];
+};
+
+static inline uint32_t uqmi_seq_write_begin(uint32_t *seq)
+{
+	uint32_t val = *seq + 1;
+
+	__atomic_store_n(seq, val, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return val;
+}
+
+static inline void uqmi_seq_write_end(uint32_t *seq, uint32_t val)
+{
+	__atomic_store_n(seq, val + 1, __ATOMIC_RELEASE);
+}
+
+/* returns an odd value while an update is in progress */
+static inline uint32_t uqmi_seq_read_begin(const uint32_t *seq)
+{
+	return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+static inline bool uqmi_seq_read_retry(const uint32_t *seq, uint32_t val)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(seq, __ATOMIC_RELAXED) != val;
+}
+
+void *uqmi_shm_map(const char *path, size_t size, bool create);
+int uqmi_shm_create(const char *path);
+int uqmi_shm_update(const char *data, unsigned int len);
+void uqmi_shm_close(void);
+int uqmi_shm_dump(const char *path);
+
+#endif
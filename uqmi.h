@@ -66,15 +66,20 @@ enum {
 #undef __qmi_service
 
 struct qmi_dev;
+struct qmi_client;
 struct qmi_request;
+struct qmi_indication;
 struct qmi_msg;
 
 typedef void (*request_cb)(struct qmi_dev *qmi, struct qmi_request *req, struct qmi_msg *msg);
+typedef void (*indication_cb)(struct qmi_dev *qmi, struct qmi_indication *ind, struct qmi_msg *msg);
 
 struct qmi_dev {
 	struct ustream_fd sf;
 
 	struct list_head req;
+	struct list_head ind;
+	struct list_head clients;
 
 	struct {
 		bool connected;
@@ -101,17 +106,44 @@ struct qmi_request {
 	bool pending;
 	bool no_error_cb;
 	uint8_t service;
+	uint8_t client_id;
 	uint16_t tid;
 	int ret;
 };
 
+/* additional client of a service, next to the one in service_data */
+struct qmi_client {
+	struct list_head list;
+
+	uint8_t service;
+	uint8_t client_id;
+	uint16_t tid;
+	bool keep;
+};
+
+struct qmi_indication {
+	struct list_head list;
+
+	indication_cb cb;
+
+	uint8_t service;
+	uint16_t message;
+};
+
 extern bool cancel_all_requests;
 int qmi_device_open(struct qmi_dev *qmi, const char *path);
 void qmi_device_close(struct qmi_dev *qmi);
 
 int qmi_request_start(struct qmi_dev *qmi, struct qmi_request *req, request_cb cb);
+int qmi_client_request_start(struct qmi_dev *qmi, struct qmi_client *cl,
+			     struct qmi_request *req, request_cb cb);
 void qmi_request_cancel(struct qmi_dev *qmi, struct qmi_request *req);
 int qmi_request_wait(struct qmi_dev *qmi, struct qmi_request *req);
+int qmi_device_wait(struct qmi_dev *qmi, bool *complete, int timeout);
+
+void qmi_indication_register(struct qmi_dev *qmi, struct qmi_indication *ind,
+			     QmiService svc, uint16_t message, indication_cb cb);
+void qmi_indication_unregister(struct qmi_dev *qmi, struct qmi_indication *ind);
 
 static inline bool qmi_request_pending(struct qmi_request *req)
 {
@@ -120,6 +152,9 @@ static inline bool qmi_request_pending(struct qmi_request *req)
 
 int qmi_service_connect(struct qmi_dev *qmi, QmiService svc, int client_id);
 int qmi_service_get_client_id(struct qmi_dev *qmi, QmiService svc);
+bool qmi_service_keep_client_id(struct qmi_dev *qmi, QmiService svc);
+int qmi_client_open(struct qmi_dev *qmi, struct qmi_client *cl, QmiService svc, int client_id);
+void qmi_client_close(struct qmi_dev *qmi, struct qmi_client *cl);
 int qmi_service_release_client_id(struct qmi_dev *qmi, QmiService svc);
 QmiService qmi_service_get_by_name(const char *str);
 const char *qmi_get_error_str(int code);